@@ -0,0 +1,206 @@
+/*
+ * Copyright 2026 Behdad Esfahbod. All Rights Reserved.
+ *
+ */
+
+#include <config.h>
+
+#include <glyphy.h>
+#include <glyphy-harfbuzz.h>
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <inttypes.h>
+#include <random>
+#include <vector>
+
+/*
+ * Time converting cubic Béziers to quadratics with glyphy_cubic_to().
+ * The cubics come from a font's outlines (CFF, or glyf with cubic
+ * contours); fonts without any, or no font at all, get random cubics
+ * instead.
+ */
+
+struct cubic_t {
+  glyphy_point_t p[4];
+};
+
+static void
+die (const char *message)
+{
+  fprintf (stderr, "%s\n", message);
+  exit (1);
+}
+
+static void
+usage (const char *argv0)
+{
+  fprintf (stderr,
+           "Usage: %s [-r repeats] [-n random-cubics] [fontfile]\n"
+           "\n"
+           "Convert every cubic of the font's outlines to quadratics, or\n"
+           "random cubics if the font has none or none is given, and report\n"
+           "the time and quadratics per cubic.\n",
+           argv0);
+}
+
+static bool
+parse_uint (const char *arg, unsigned int *value)
+{
+  char *end = NULL;
+  unsigned long parsed = strtoul (arg, &end, 10);
+
+  if (!arg[0] || !end || *end || parsed > UINT_MAX)
+    return false;
+
+  *value = (unsigned int) parsed;
+  return true;
+}
+
+static void
+collect_cubic_to (hb_draw_funcs_t *dfuncs,
+                  std::vector<cubic_t> *cubics,
+                  hb_draw_state_t *st,
+                  float control1_x, float control1_y,
+                  float control2_x, float control2_y,
+                  float to_x, float to_y,
+                  void *user_data)
+{
+  cubic_t c = {{{(double) st->current_x, (double) st->current_y},
+                {(double) control1_x, (double) control1_y},
+                {(double) control2_x, (double) control2_y},
+                {(double) to_x, (double) to_y}}};
+  cubics->push_back (c);
+}
+
+static void
+load_font_cubics (const char *font_path, std::vector<cubic_t> &cubics)
+{
+  hb_blob_t *blob = hb_blob_create_from_file_or_fail (font_path);
+  if (!blob)
+    die ("Failed to open font file");
+  hb_face_t *face = hb_face_create (blob, 0);
+  hb_font_t *font = hb_font_create (face);
+
+  hb_draw_funcs_t *dfuncs = hb_draw_funcs_create ();
+  hb_draw_funcs_set_cubic_to_func (dfuncs, (hb_draw_cubic_to_func_t) collect_cubic_to, NULL, NULL);
+  hb_draw_funcs_make_immutable (dfuncs);
+
+  unsigned int glyph_count = hb_face_get_glyph_count (face);
+  for (unsigned int glyph = 0; glyph < glyph_count; glyph++)
+    hb_font_draw_glyph (font, glyph, dfuncs, &cubics);
+
+  hb_draw_funcs_destroy (dfuncs);
+  hb_font_destroy (font);
+  hb_face_destroy (face);
+  hb_blob_destroy (blob);
+}
+
+/* Glyph-like cubics: endpoints up to 300 units apart, with control
+ * arms of a fifth to two thirds of that, near the chord. */
+static void
+make_random_cubics (unsigned int count, std::vector<cubic_t> &cubics)
+{
+  std::mt19937 rng (1);
+  std::uniform_real_distribution<double> coord (0, 1000);
+  std::uniform_real_distribution<double> delta (-150, 150);
+  std::uniform_real_distribution<double> arm (0.2, 0.67);
+  std::uniform_real_distribution<double> turn (-0.5, 0.5);
+
+  for (unsigned int i = 0; i < count; i++) {
+    glyphy_point_t a = {coord (rng), coord (rng)};
+    glyphy_point_t b = {a.x + delta (rng), a.y + delta (rng)};
+    double angle = atan2 (b.y - a.y, b.x - a.x);
+    double len = hypot (b.x - a.x, b.y - a.y);
+    double s1 = arm (rng) * len, t1 = angle + turn (rng);
+    double s2 = arm (rng) * len, t2 = angle + turn (rng);
+    cubic_t c = {{a,
+                  {a.x + cos (t1) * s1, a.y + sin (t1) * s1},
+                  {b.x - cos (t2) * s2, b.y - sin (t2) * s2},
+                  b}};
+    cubics.push_back (c);
+  }
+}
+
+int
+main (int argc, char **argv)
+{
+  const char *font_path = NULL;
+  unsigned int repeats = 10;
+  unsigned int num_random = 100000;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp (argv[i], "-h") || !strcmp (argv[i], "--help")) {
+      usage (argv[0]);
+      return 0;
+    }
+    if (!strcmp (argv[i], "-r") || !strcmp (argv[i], "--repeats")) {
+      if (++i >= argc || !parse_uint (argv[i], &repeats) || !repeats) {
+        usage (argv[0]);
+        return 1;
+      }
+      continue;
+    }
+    if (!strcmp (argv[i], "-n") || !strcmp (argv[i], "--random-cubics")) {
+      if (++i >= argc || !parse_uint (argv[i], &num_random) || !num_random) {
+        usage (argv[0]);
+        return 1;
+      }
+      continue;
+    }
+    if (argv[i][0] == '-' || font_path) {
+      usage (argv[0]);
+      return 1;
+    }
+    font_path = argv[i];
+  }
+
+  std::vector<cubic_t> cubics;
+  if (font_path)
+    load_font_cubics (font_path, cubics);
+  const char *source = font_path && !cubics.empty () ? font_path : "random";
+  if (cubics.empty ())
+    make_random_cubics (num_random, cubics);
+
+  typedef std::chrono::steady_clock clock;
+  glyphy_t *g = glyphy_create ();
+  uint64_t quadratics = 0;
+  uint64_t convert_ns = 0;
+
+  /* Start afresh every so often, so that the curve list stays small. */
+  const unsigned int batch = 1024;
+  for (unsigned int repeat = 0; repeat < repeats; repeat++)
+    for (size_t first = 0; first < cubics.size (); first += batch) {
+      size_t last = std::min (first + batch, cubics.size ());
+      glyphy_reset (g);
+
+      clock::time_point start = clock::now ();
+      for (size_t i = first; i < last; i++) {
+        const cubic_t &c = cubics[i];
+        glyphy_move_to (g, &c.p[0]);
+        glyphy_cubic_to (g, &c.p[1], &c.p[2], &c.p[3]);
+      }
+      convert_ns += std::chrono::duration_cast<std::chrono::nanoseconds> (clock::now () - start).count ();
+
+      if (!glyphy_successful (g))
+        die ("Failed accumulating curves");
+      if (!repeat)
+        quadratics += glyphy_get_num_curves (g);
+    }
+
+  uint64_t conversions = (uint64_t) cubics.size () * repeats;
+  printf ("cubics: %zu from %s, %u repeats\n", cubics.size (), source, repeats);
+  printf ("quadratics: %" PRIu64 ", %.2f per cubic\n",
+          quadratics, (double) quadratics / cubics.size ());
+  printf ("cu2qu: %8.3fms total, %.1fns/cubic\n",
+          convert_ns / 1000000., (double) convert_ns / conversions);
+
+  glyphy_destroy (g);
+
+  return 0;
+}
@@ -8,24 +8,48 @@
 #include <glyphy.h>
 #include <glyphy-harfbuzz.h>
 
+#include <atomic>
 #include <chrono>
 #include <climits>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <inttypes.h>
+#include <new>
 #include <vector>
 
 struct bench_stats_t {
   uint64_t glyphs;
   uint64_t non_empty_glyphs;
   uint64_t curves;
+  uint64_t drawn_curves;
   uint64_t blob_bytes;
+  uint64_t encode_allocs;
   uint64_t outline_ns;
   uint64_t encode_ns;
   uint64_t wall_ns;
 };
 
+/* Count heap allocations, so we can verify that steady-state encoding
+ * does not allocate. */
+static std::atomic<uint64_t> num_allocs;
+
+void *
+operator new (size_t size)
+{
+  num_allocs++;
+  void *p = malloc (size ? size : 1);
+  if (!p)
+    abort ();
+  return p;
+}
+
+void
+operator delete (void *p) noexcept
+{
+  free (p);
+}
+
 static void
 die (const char *message)
 {
@@ -37,9 +61,25 @@ static void
 usage (const char *argv0)
 {
   fprintf (stderr,
-           "Usage: %s [-r repeats] fontfile\n"
+           "Usage: %s [-r repeats] [-j threads] [--bounded-indices]\n"
+           "          [--adaptive-bands [--max-blob-len texels]] [--balanced-bands]\n"
+           "          [--fixed-point] [--native-cubics] [--simplify]\n"
+           "          [--remove-overlaps] [--cell-grid] [--sub-bands] [--single-axis]\n"
+           "          [--glyf] [--cu2qu-tolerance units | --cu2qu-max-ppem ppem]\n"
+           "          fontfile\n"
            "\n"
            "Encode all glyphs in a font and report outline and blob timings.\n"
+           "With -j, encode with glyphy_encode_parallel() and only report\n"
+           "the combined outline and encode time.\n"
+           "--bounded-indices, --adaptive-bands, --balanced-bands, --fixed-point,\n"
+           "--native-cubics, --simplify, --remove-overlaps, --cell-grid, --sub-bands\n"
+           "and --single-axis set the matching GLYPHY_FLAG_* encoding flags;\n"
+           "without -j, curve counts are reported both as drawn and as encoded.\n"
+           "--glyf reads TrueType outlines directly instead of through\n"
+           "hb_font_draw_glyph(), falling back to it where needed.\n"
+           "--cu2qu-tolerance sets how far, in font units, quadratics may stray\n"
+           "from the font's cubics; --cu2qu-max-ppem sets it to 1/8 pixel at\n"
+           "that size.  Compare curve counts and blob sizes across values.\n"
            "Texture upload is not measured.\n",
            argv0);
 }
@@ -57,6 +97,19 @@ parse_uint (const char *arg, unsigned int *value)
   return true;
 }
 
+static bool
+parse_positive_double (const char *arg, double *value)
+{
+  char *end = NULL;
+  double parsed = strtod (arg, &end);
+
+  if (!arg[0] || !end || *end || !(parsed > 0))
+    return false;
+
+  *value = parsed;
+  return true;
+}
+
 static double
 ns_to_ms (uint64_t ns)
 {
@@ -83,12 +136,20 @@ megabytes_per_second (uint64_t bytes, uint64_t ns)
 
 static bench_stats_t
 benchmark_font (hb_face_t    *face,
-                unsigned int  repeats)
+                unsigned int  repeats,
+                unsigned int  flags,
+                unsigned int  max_blob_len,
+                double        cu2qu_tolerance,
+                bool          glyf)
 {
   bench_stats_t stats = {};
   hb_font_t *font = hb_font_create (face);
+  glyphy_harfbuzz(glyf_reader_t) *reader = glyf ? glyphy_harfbuzz(glyf_reader_create) (font) : NULL;
   glyphy_t *g = glyphy_create ();
-  std::vector<glyphy_texel_t> scratch_buffer (1u << 20);
+  glyphy_set_flags (g, flags);
+  glyphy_set_max_blob_len (g, max_blob_len);
+  glyphy_set_cu2qu_tolerance (g, cu2qu_tolerance);
+  std::vector<glyphy_texel_t> scratch_buffer;
   unsigned int glyph_count = hb_face_get_glyph_count (face);
 
   if (!glyph_count)
@@ -105,7 +166,10 @@ benchmark_font (hb_face_t    *face,
       glyphy_reset (g);
 
       clock::time_point outline_start = clock::now ();
-      glyphy_harfbuzz(font_get_glyph_shape) (font, glyph_index, g);
+      if (reader)
+        glyphy_harfbuzz(glyf_reader_get_glyph_shape) (reader, glyph_index, g);
+      else
+        glyphy_harfbuzz(font_get_glyph_shape) (font, glyph_index, g);
       clock::time_point outline_end = clock::now ();
 
       if (!glyphy_successful (g)) {
@@ -115,7 +179,22 @@ benchmark_font (hb_face_t    *face,
         die (message);
       }
 
+      stats.drawn_curves += glyphy_get_num_curves (g);
+
+      uint64_t allocs_start = num_allocs;
       clock::time_point encode_start = clock::now ();
+      if (!glyphy_encode_size (g, &output_len)) {
+        char message[128];
+        snprintf (message, sizeof (message),
+                  "Failed sizing blob for glyph %u", glyph_index);
+        die (message);
+      }
+      if (output_len > scratch_buffer.size ()) {
+        /* Growing the buffer is the bench's allocation, not glyphy's. */
+        uint64_t allocs = num_allocs;
+        scratch_buffer.resize (output_len);
+        allocs_start += num_allocs - allocs;
+      }
       if (!glyphy_encode (g,
                           scratch_buffer.data (),
                           scratch_buffer.size (),
@@ -127,12 +206,14 @@ benchmark_font (hb_face_t    *face,
         die (message);
       }
       clock::time_point encode_end = clock::now ();
+      uint64_t allocs_end = num_allocs;
 
       stats.glyphs++;
       if (!glyphy_extents_is_empty (&extents))
         stats.non_empty_glyphs++;
       stats.curves += glyphy_get_num_curves (g);
       stats.blob_bytes += (uint64_t) output_len * sizeof (glyphy_texel_t);
+      stats.encode_allocs += allocs_end - allocs_start;
       stats.outline_ns += std::chrono::duration_cast<std::chrono::nanoseconds> (outline_end - outline_start).count ();
       stats.encode_ns += std::chrono::duration_cast<std::chrono::nanoseconds> (encode_end - encode_start).count ();
     }
@@ -140,6 +221,91 @@ benchmark_font (hb_face_t    *face,
 
   stats.wall_ns = std::chrono::duration_cast<std::chrono::nanoseconds> (clock::now () - wall_start).count ();
 
+  glyphy_destroy (g);
+  glyphy_harfbuzz(glyf_reader_destroy) (reader);
+  hb_font_destroy (font);
+
+  return stats;
+}
+
+static bench_stats_t
+benchmark_font_parallel (hb_face_t    *face,
+                         unsigned int  repeats,
+                         unsigned int  threads,
+                         unsigned int  flags,
+                         unsigned int  max_blob_len,
+                         double        cu2qu_tolerance,
+                         bool          glyf)
+{
+  bench_stats_t stats = {};
+  hb_font_t *font = hb_font_create (face);
+  glyphy_t *g = glyphy_create ();
+  glyphy_set_flags (g, flags);
+  glyphy_set_max_blob_len (g, max_blob_len);
+  glyphy_set_cu2qu_tolerance (g, cu2qu_tolerance);
+  unsigned int glyph_count = hb_face_get_glyph_count (face);
+
+  if (!glyph_count)
+    die ("Font has no glyphs");
+
+  std::vector<hb_codepoint_t> glyphs (glyph_count);
+  for (unsigned int i = 0; i < glyph_count; i++)
+    glyphs[i] = i;
+  std::vector<glyphy_glyph_blob_t> blobs (glyph_count);
+  std::vector<glyphy_texel_t> buffer;
+
+  /* With --glyf, one reader per thread, each on a sub-font. */
+  std::vector<void *> readers;
+  if (glyf)
+    for (unsigned int i = 0; i < threads; i++) {
+      hb_font_t *sub_font = hb_font_create_sub_font (font);
+      readers.push_back (glyphy_harfbuzz(glyf_reader_create) (sub_font));
+      hb_font_destroy (sub_font);
+    }
+
+  typedef std::chrono::steady_clock clock;
+
+  /* The first round sizes the buffer and is not measured. */
+  for (unsigned int repeat = 0; repeat <= repeats; repeat++) {
+    unsigned int output_len = 0;
+
+    clock::time_point start = clock::now ();
+    if (!(glyf ? glyphy_encode_parallel (g, threads,
+                                         glyphy_harfbuzz(glyf_get_glyph_shape),
+                                         readers.data (),
+                                         (const unsigned int *) glyphs.data (), glyph_count,
+                                         buffer.data (), buffer.size (),
+                                         &output_len,
+                                         blobs.data ())
+               : glyphy_harfbuzz(font_encode_glyphs_parallel) (font, g, threads,
+                                                               glyphs.data (), glyph_count,
+                                                               buffer.data (), buffer.size (),
+                                                               &output_len,
+                                                               blobs.data ()))) {
+      for (unsigned int i = 0; i < glyph_count; i++)
+        if (blobs[i].failed)
+          die ("Failed encoding glyphs");
+      buffer.resize (output_len);
+      if (!glyphy_copy_parallel_blobs (g, buffer.data (), buffer.size ()))
+        die ("Failed copying blobs");
+    }
+    clock::time_point end = clock::now ();
+
+    if (!repeat)
+      continue;
+
+    for (unsigned int i = 0; i < glyph_count; i++) {
+      stats.glyphs++;
+      if (!glyphy_extents_is_empty (&blobs[i].extents))
+        stats.non_empty_glyphs++;
+      stats.curves += blobs[i].num_curves;
+      stats.blob_bytes += (uint64_t) blobs[i].length * sizeof (glyphy_texel_t);
+    }
+    stats.wall_ns += std::chrono::duration_cast<std::chrono::nanoseconds> (end - start).count ();
+  }
+
+  for (void *reader : readers)
+    glyphy_harfbuzz(glyf_reader_destroy) ((glyphy_harfbuzz(glyf_reader_t) *) reader);
   glyphy_destroy (g);
   hb_font_destroy (font);
 
@@ -151,6 +317,12 @@ main (int argc, char **argv)
 {
   const char *font_path = NULL;
   unsigned int repeats = 1;
+  unsigned int threads = 0;
+  unsigned int flags = GLYPHY_FLAG_DEFAULT;
+  unsigned int max_blob_len = 0;
+  double cu2qu_tolerance = 0;
+  unsigned int cu2qu_max_ppem = 0;
+  bool glyf = false;
 
   for (int i = 1; i < argc; i++) {
     if (!strcmp (argv[i], "-h") || !strcmp (argv[i], "--help")) {
@@ -164,6 +336,78 @@ main (int argc, char **argv)
       }
       continue;
     }
+    if (!strcmp (argv[i], "-j") || !strcmp (argv[i], "--threads")) {
+      if (++i >= argc || !parse_uint (argv[i], &threads) || !threads) {
+        usage (argv[0]);
+        return 1;
+      }
+      continue;
+    }
+    if (!strcmp (argv[i], "--bounded-indices")) {
+      flags |= GLYPHY_FLAG_BOUNDED_INDICES;
+      continue;
+    }
+    if (!strcmp (argv[i], "--adaptive-bands")) {
+      flags |= GLYPHY_FLAG_ADAPTIVE_BANDS;
+      continue;
+    }
+    if (!strcmp (argv[i], "--balanced-bands")) {
+      flags |= GLYPHY_FLAG_BALANCED_BANDS;
+      continue;
+    }
+    if (!strcmp (argv[i], "--fixed-point")) {
+      flags |= GLYPHY_FLAG_FIXED_POINT;
+      continue;
+    }
+    if (!strcmp (argv[i], "--native-cubics")) {
+      flags |= GLYPHY_FLAG_NATIVE_CUBICS;
+      continue;
+    }
+    if (!strcmp (argv[i], "--simplify")) {
+      flags |= GLYPHY_FLAG_SIMPLIFY;
+      continue;
+    }
+    if (!strcmp (argv[i], "--remove-overlaps")) {
+      flags |= GLYPHY_FLAG_REMOVE_OVERLAPS;
+      continue;
+    }
+    if (!strcmp (argv[i], "--cell-grid")) {
+      flags |= GLYPHY_FLAG_CELL_GRID;
+      continue;
+    }
+    if (!strcmp (argv[i], "--sub-bands")) {
+      flags |= GLYPHY_FLAG_SUB_BANDS;
+      continue;
+    }
+    if (!strcmp (argv[i], "--single-axis")) {
+      flags |= GLYPHY_FLAG_SINGLE_AXIS;
+      continue;
+    }
+    if (!strcmp (argv[i], "--glyf")) {
+      glyf = true;
+      continue;
+    }
+    if (!strcmp (argv[i], "--max-blob-len")) {
+      if (++i >= argc || !parse_uint (argv[i], &max_blob_len)) {
+        usage (argv[0]);
+        return 1;
+      }
+      continue;
+    }
+    if (!strcmp (argv[i], "--cu2qu-tolerance")) {
+      if (++i >= argc || !parse_positive_double (argv[i], &cu2qu_tolerance) || cu2qu_max_ppem) {
+        usage (argv[0]);
+        return 1;
+      }
+      continue;
+    }
+    if (!strcmp (argv[i], "--cu2qu-max-ppem")) {
+      if (++i >= argc || !parse_uint (argv[i], &cu2qu_max_ppem) || !cu2qu_max_ppem || cu2qu_tolerance) {
+        usage (argv[0]);
+        return 1;
+      }
+      continue;
+    }
     if (argv[i][0] == '-') {
       usage (argv[0]);
       return 1;
@@ -185,7 +429,19 @@ main (int argc, char **argv)
     die ("Failed to open font file");
 
   hb_face_t *face = hb_face_create (blob, 0);
-  bench_stats_t stats = benchmark_font (face, repeats);
+  if (cu2qu_max_ppem)
+    cu2qu_tolerance = hb_face_get_upem (face) / (8. * cu2qu_max_ppem);
+  if (!cu2qu_tolerance) {
+    glyphy_t *g = glyphy_create ();
+    cu2qu_tolerance = glyphy_get_cu2qu_tolerance (g);
+    glyphy_destroy (g);
+  }
+
+  bench_stats_t stats = threads ? benchmark_font_parallel (face, repeats, threads,
+                                                         flags, max_blob_len,
+                                                         cu2qu_tolerance, glyf)
+                                : benchmark_font (face, repeats, flags, max_blob_len,
+                                                  cu2qu_tolerance, glyf);
   unsigned int glyph_count = hb_face_get_glyph_count (face);
   double avg_curves = stats.glyphs ? (double) stats.curves / stats.glyphs : 0.;
   double avg_blob_kb = stats.glyphs ? stats.blob_bytes / 1024. / stats.glyphs : 0.;
@@ -197,18 +453,35 @@ main (int argc, char **argv)
           stats.blob_bytes,
           stats.blob_bytes / 1024.);
   printf ("avg curves per glyph: %.2f\n", avg_curves);
+  if (!threads)
+    printf ("curves: %" PRIu64 " drawn, %" PRIu64 " encoded (%.2f%% fewer)\n",
+            stats.drawn_curves, stats.curves,
+            stats.drawn_curves ? 100. * (stats.drawn_curves - stats.curves) / stats.drawn_curves : 0.);
   printf ("avg blob size per glyph: %.2fkb\n", avg_blob_kb);
-  printf ("outline: %8.3fms total, %.3fus/glyph, %.0f glyphs/s\n",
-          ns_to_ms (stats.outline_ns),
-          ns_to_us_per_glyph (stats.outline_ns, stats.glyphs),
-          glyphs_per_second (stats.glyphs, stats.outline_ns));
-  printf ("encode:  %8.3fms total, %.3fus/glyph, %.0f glyphs/s, %.2f MiB/s\n",
-          ns_to_ms (stats.encode_ns),
-          ns_to_us_per_glyph (stats.encode_ns, stats.glyphs),
-          glyphs_per_second (stats.glyphs, stats.encode_ns),
-          megabytes_per_second (stats.blob_bytes, stats.encode_ns));
-  printf ("wall:    %8.3fms total (outline + encode + loop overhead)\n",
-          ns_to_ms (stats.wall_ns));
+  printf ("cu2qu tolerance: %g units\n", cu2qu_tolerance);
+  if (threads) {
+    printf ("threads: %u\n", threads);
+    printf ("encode:  %8.3fms total, %.3fus/glyph, %.0f glyphs/s, %.2f MiB/s (outline + encode)\n",
+            ns_to_ms (stats.wall_ns),
+            ns_to_us_per_glyph (stats.wall_ns, stats.glyphs),
+            glyphs_per_second (stats.glyphs, stats.wall_ns),
+            megabytes_per_second (stats.blob_bytes, stats.wall_ns));
+  } else {
+    printf ("outline: %8.3fms total, %.3fus/glyph, %.0f glyphs/s\n",
+            ns_to_ms (stats.outline_ns),
+            ns_to_us_per_glyph (stats.outline_ns, stats.glyphs),
+            glyphs_per_second (stats.glyphs, stats.outline_ns));
+    printf ("encode:  %8.3fms total, %.3fus/glyph, %.0f glyphs/s, %.2f MiB/s\n",
+            ns_to_ms (stats.encode_ns),
+            ns_to_us_per_glyph (stats.encode_ns, stats.glyphs),
+            glyphs_per_second (stats.glyphs, stats.encode_ns),
+            megabytes_per_second (stats.blob_bytes, stats.encode_ns));
+    printf ("encode allocations: %" PRIu64 " total, %.3f/glyph\n",
+            stats.encode_allocs,
+            stats.glyphs ? (double) stats.encode_allocs / stats.glyphs : 0.);
+    printf ("wall:    %8.3fms total (outline + encode + loop overhead)\n",
+            ns_to_ms (stats.wall_ns));
+  }
 
   hb_face_destroy (face);
   hb_blob_destroy (blob);
@@ -0,0 +1,243 @@
+/*
+ * Copyright 2026 Behdad Esfahbod. All Rights Reserved.
+ *
+ */
+
+#include <config.h>
+
+#include <glyphy.h>
+#include <glyphy-harfbuzz.h>
+
+/* Internal: curve access and the encoder's band list sort. */
+#include "glyphy.hh"
+#include "glyphy-sort.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <inttypes.h>
+#include <vector>
+
+/*
+ * Time sorting curve lists the way the encoder sorts band lists: by max
+ * x descending, min x ascending, max y descending and min y ascending.
+ * Each glyph's whole curve list is sorted, as happens in a band that
+ * spans the glyph; -g joins consecutive glyphs to model glyphs with
+ * more curves than the font has.
+ */
+
+struct curve_keys_t {
+  double  bounds[4];  /* max_x, min_x, max_y, min_y */
+  int16_t qbounds[4]; /* Quantized */
+};
+
+static const bool key_descending[4] = {true, false, true, false};
+
+static void
+die (const char *message)
+{
+  fprintf (stderr, "%s\n", message);
+  exit (1);
+}
+
+static void
+usage (const char *argv0)
+{
+  fprintf (stderr,
+           "Usage: %s [-r repeats] [-g glyphs-per-list] fontfile\n"
+           "\n"
+           "Sort each glyph's curves by the four band list keys with\n"
+           "std::sort on double keys, as the encoder used to, with a stable\n"
+           "comparison sort on quantized keys, and with the radix sort the\n"
+           "encoder uses.  The last two must agree.  The radix sort may only\n"
+           "differ from std::sort among curves whose keys are equal once\n"
+           "quantized.\n",
+           argv0);
+}
+
+static bool
+parse_uint (const char *arg, unsigned int *value)
+{
+  char *end = NULL;
+  unsigned long parsed = strtoul (arg, &end, 10);
+
+  if (!arg[0] || !end || *end || parsed > UINT_MAX)
+    return false;
+
+  *value = (unsigned int) parsed;
+  return true;
+}
+
+/* Curve keys of each list, back to back; list i is
+ * [list_starts[i], list_starts[i + 1]). */
+static void
+load_lists (hb_face_t                  *face,
+            unsigned int                glyphs_per_list,
+            std::vector<curve_keys_t>  &keys,
+            std::vector<unsigned int>  &list_starts)
+{
+  hb_font_t *font = hb_font_create (face);
+  glyphy_t *g = glyphy_create ();
+  unsigned int glyph_count = hb_face_get_glyph_count (face);
+
+  list_starts.push_back (0);
+  for (unsigned int glyph = 0; glyph < glyph_count; glyph++) {
+    glyphy_reset (g);
+    glyphy_harfbuzz(font_get_glyph_shape) (font, glyph, g);
+    if (!glyphy_successful (g))
+      die ("Failed accumulating curves");
+
+    for (unsigned int ci = 0; ci < g->curves.size (); ci++) {
+      glyphy_curve_t c = g->curves[ci];
+      curve_keys_t k;
+      k.bounds[0] = std::max (std::max (c.p1.x, c.p2.x), c.p3.x);
+      k.bounds[1] = std::min (std::min (c.p1.x, c.p2.x), c.p3.x);
+      k.bounds[2] = std::max (std::max (c.p1.y, c.p2.y), c.p3.y);
+      k.bounds[3] = std::min (std::min (c.p1.y, c.p2.y), c.p3.y);
+      for (unsigned int i = 0; i < 4; i++)
+        k.qbounds[i] = glyphy_quantize (k.bounds[i]);
+      keys.push_back (k);
+    }
+
+    if ((glyph + 1) % glyphs_per_list == 0 || glyph + 1 == glyph_count)
+      if (keys.size () > list_starts.back ())
+        list_starts.push_back (keys.size ());
+  }
+
+  glyphy_destroy (g);
+  hb_font_destroy (font);
+}
+
+int
+main (int argc, char **argv)
+{
+  const char *font_path = NULL;
+  unsigned int repeats = 10;
+  unsigned int glyphs_per_list = 1;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp (argv[i], "-h") || !strcmp (argv[i], "--help")) {
+      usage (argv[0]);
+      return 0;
+    }
+    if (!strcmp (argv[i], "-r") || !strcmp (argv[i], "--repeats")) {
+      if (++i >= argc || !parse_uint (argv[i], &repeats) || !repeats) {
+        usage (argv[0]);
+        return 1;
+      }
+      continue;
+    }
+    if (!strcmp (argv[i], "-g") || !strcmp (argv[i], "--glyphs-per-list")) {
+      if (++i >= argc || !parse_uint (argv[i], &glyphs_per_list) || !glyphs_per_list) {
+        usage (argv[0]);
+        return 1;
+      }
+      continue;
+    }
+    if (argv[i][0] == '-' || font_path) {
+      usage (argv[0]);
+      return 1;
+    }
+    font_path = argv[i];
+  }
+
+  if (!font_path) {
+    usage (argv[0]);
+    return 1;
+  }
+
+  hb_blob_t *blob = hb_blob_create_from_file_or_fail (font_path);
+  if (!blob)
+    die ("Failed to open font file");
+  hb_face_t *face = hb_face_create (blob, 0);
+
+  std::vector<curve_keys_t> keys;
+  std::vector<unsigned int> list_starts;
+  load_lists (face, glyphs_per_list, keys, list_starts);
+  unsigned int num_lists = list_starts.size () - 1;
+  if (!num_lists)
+    die ("Font has no curves");
+
+  unsigned int longest = 0;
+  for (unsigned int l = 0; l < num_lists; l++)
+    longest = std::max (longest, list_starts[l + 1] - list_starts[l]);
+
+  std::vector<unsigned int> indices (longest);
+  std::vector<glyphy_sort_item_t> items (longest), reference (longest), tmp (longest);
+
+  typedef std::chrono::steady_clock clock;
+  uint64_t std_sort_ns = 0, comparison_ns = 0, radix_ns = 0;
+  uint64_t mismatches = 0;
+  uint64_t tie_differences = 0, key_differences = 0;
+
+  for (unsigned int repeat = 0; repeat < repeats; repeat++)
+    for (unsigned int l = 0; l < num_lists; l++) {
+      const curve_keys_t *list = &keys[list_starts[l]];
+      unsigned int count = list_starts[l + 1] - list_starts[l];
+
+      for (unsigned int k = 0; k < 4; k++) {
+        bool descending = key_descending[k];
+
+        for (unsigned int i = 0; i < count; i++)
+          indices[i] = i;
+        clock::time_point start = clock::now ();
+        std::sort (indices.begin (), indices.begin () + count,
+                   [&] (unsigned int a, unsigned int b) {
+                     return descending ? list[a].bounds[k] > list[b].bounds[k]
+                                       : list[a].bounds[k] < list[b].bounds[k];
+                   });
+        std_sort_ns += std::chrono::duration_cast<std::chrono::nanoseconds> (clock::now () - start).count ();
+
+        for (unsigned int i = 0; i < count; i++) {
+          reference[i].key = glyphy_sort_key (list[i].qbounds[k], descending);
+          reference[i].value = i;
+        }
+        std::copy (reference.begin (), reference.begin () + count, items.begin ());
+        start = clock::now ();
+        glyphy_comparison_sort (reference.data (), count);
+        comparison_ns += std::chrono::duration_cast<std::chrono::nanoseconds> (clock::now () - start).count ();
+
+        start = clock::now ();
+        glyphy_radix_sort (items.data (), tmp.data (), count);
+        radix_ns += std::chrono::duration_cast<std::chrono::nanoseconds> (clock::now () - start).count ();
+
+        for (unsigned int i = 0; i < count; i++)
+          if (items[i].value != reference[i].value)
+            mismatches++;
+
+        /* Against the old order, curves may only trade places with
+         * others of the same quantized key. */
+        for (unsigned int i = 0; i < count; i++) {
+          if (items[i].value == indices[i])
+            continue;
+          if (list[items[i].value].qbounds[k] == list[indices[i]].qbounds[k])
+            tie_differences++;
+          else
+            key_differences++;
+        }
+      }
+    }
+
+  uint64_t sorts = (uint64_t) num_lists * 4 * repeats;
+  printf ("font: %s\n", font_path);
+  printf ("lists: %u x 4 keys x %u repeats, %.1f curves avg, %u max\n",
+          num_lists, repeats, (double) keys.size () / num_lists, longest);
+  printf ("std::sort (double):   %8.3fms total, %.1fns/sort\n",
+          std_sort_ns / 1000000., (double) std_sort_ns / sorts);
+  printf ("stable_sort (int16):  %8.3fms total, %.1fns/sort\n",
+          comparison_ns / 1000000., (double) comparison_ns / sorts);
+  printf ("radix sort (int16):   %8.3fms total, %.1fns/sort, %.2fx vs std::sort\n",
+          radix_ns / 1000000., (double) radix_ns / sorts,
+          radix_ns ? (double) std_sort_ns / radix_ns : 0.);
+  printf ("order mismatches: %" PRIu64 "\n", mismatches);
+  printf ("differences from std::sort: %" PRIu64 " among quantized ties, %" PRIu64 " otherwise\n",
+          tie_differences, key_differences);
+
+  hb_face_destroy (face);
+  hb_blob_destroy (blob);
+
+  return mismatches || key_differences ? 1 : 0;
+}
@@ -100,6 +100,12 @@ demo_buffer_add_text (demo_buffer_t        *buffer,
     unsigned count;
     hb_glyph_info_t *infos = hb_buffer_get_glyph_infos (hb_buffer, &count);
     hb_glyph_position_t *pos = hb_buffer_get_glyph_positions (hb_buffer, NULL);
+
+    std::vector<unsigned int> glyph_indices (count);
+    for (unsigned i = 0; i < count; i++)
+      glyph_indices[i] = infos[i].codepoint;
+    demo_font_prefetch_glyphs (font, glyph_indices.data (), count);
+
     for (unsigned i = 0; i < count; i++)
     {
       unsigned int glyph_index = infos[i].codepoint;
@@ -177,6 +183,12 @@ demo_buffer_draw (demo_buffer_t *buffer)
   glVertexAttribPointer (loc_epp, 1, GL_FLOAT, GL_FALSE, stride,
                          (const void *) offsetof (glyph_vertex_t, emPerPos));
 
+  /* a_singleAxisPpem: float */
+  GLint loc_sap = glGetAttribLocation (program, "a_singleAxisPpem");
+  glEnableVertexAttribArray (loc_sap);
+  glVertexAttribPointer (loc_sap, 1, GL_FLOAT, GL_FALSE, stride,
+                         (const void *) offsetof (glyph_vertex_t, singleAxisPpem));
+
   /* a_glyphLoc: uint */
   GLint loc_glyph = glGetAttribLocation (program, "a_glyphLoc");
   glEnableVertexAttribArray (loc_glyph);
@@ -189,6 +201,7 @@ demo_buffer_draw (demo_buffer_t *buffer)
   glDisableVertexAttribArray (loc_tex);
   glDisableVertexAttribArray (loc_normal);
   glDisableVertexAttribArray (loc_epp);
+  glDisableVertexAttribArray (loc_sap);
   glDisableVertexAttribArray (loc_glyph);
   glBindVertexArray (0);
 }
@@ -74,51 +74,123 @@ demo_font_get_font (demo_font_t *font)
 }
 
 
+/* Smallest size, in pixels per em, that tiled glyphs join seamlessly
+ * at.  Smaller sizes cost curves per tile. */
+#define DEMO_TILE_MIN_PPEM 8.
+
+/* Encodes the glyph drawn into font->g as tiles, and uploads them. */
 static void
-encode_glyph (demo_font_t      *font,
-              unsigned int      glyph_index,
-              glyphy_texel_t   *buffer,
-              unsigned int      buffer_len,
-              unsigned int     *output_len,
-              glyphy_extents_t *extents,
-              double           *advance)
+encode_tiles (demo_font_t  *font,
+              unsigned int  glyph)
 {
-  glyphy_reset (font->g);
-
-  glyphy_harfbuzz(font_get_glyph_shape) (font->font, glyph_index, font->g);
-  if (!glyphy_successful (font->g))
-    die ("Failed accumulating curves");
-
-  if (!glyphy_encode (font->g, buffer, buffer_len, output_len, extents))
-    die ("Failed encoding blob");
-
-  *advance = hb_font_get_glyph_h_advance (font->font, glyph_index);
+  glyph_info_t glyph_info;
+  std::vector<glyphy_tile_t> &tiles = glyph_info.tiles;
+  tiles.resize (16);
+
+  /* Em units here are font units. */
+  double min_ppem = DEMO_TILE_MIN_PPEM / hb_face_get_upem (font->face);
+  unsigned int output_len, num_tiles;
+  while (!glyphy_encode_tiles (font->g,
+                               min_ppem,
+                               font->scratch_buffer->data (),
+                               font->scratch_buffer->size (),
+                               &output_len,
+                               &glyph_info.extents,
+                               tiles.data (), tiles.size (),
+                               &num_tiles))
+  {
+    if (output_len <= font->scratch_buffer->size () && num_tiles <= tiles.size ())
+      die ("Failed encoding blob");
+    font->scratch_buffer->resize (std::max (output_len, (unsigned int) font->scratch_buffer->size ()));
+    tiles.resize (std::max (num_tiles, (unsigned int) tiles.size ()));
+  }
+  tiles.resize (num_tiles);
+
+  unsigned int atlas_offset = demo_atlas_alloc (font->atlas,
+                                                font->scratch_buffer->data (),
+                                                output_len);
+  for (unsigned int i = 0; i < num_tiles; i++)
+    tiles[i].offset += atlas_offset;
+
+  glyph_info.advance = hb_font_get_glyph_h_advance (font->font, glyph);
+  glyph_info.upem = hb_face_get_upem (font->face);
+  glyph_info.is_empty = !num_tiles;
+  glyph_info.atlas_offset = 0;
+  (*font->glyph_cache)[glyph] = glyph_info;
 
   font->num_glyphs++;
   font->sum_curves += glyphy_get_num_curves (font->g);
-  font->sum_bytes += (*output_len * sizeof (glyphy_texel_t));
+  font->sum_bytes += output_len * sizeof (glyphy_texel_t);
 }
 
-static void
-_demo_font_upload_glyph (demo_font_t *font,
-                         unsigned int glyph_index,
-                         glyph_info_t *glyph_info)
+void
+demo_font_prefetch_glyphs (demo_font_t        *font,
+                           const unsigned int *glyph_indices,
+                           unsigned int        count)
 {
-  unsigned int output_len;
-
-  encode_glyph (font,
-                glyph_index,
-                font->scratch_buffer->data (), font->scratch_buffer->size (),
-                &output_len,
-                &glyph_info->extents,
-                &glyph_info->advance);
-
-  glyph_info->upem = hb_face_get_upem (font->face);
-  glyph_info->is_empty = glyphy_extents_is_empty (&glyph_info->extents);
-  if (!glyph_info->is_empty)
-    glyph_info->atlas_offset = demo_atlas_alloc (font->atlas,
-                                                 font->scratch_buffer->data (),
-                                                 output_len);
+  std::vector<unsigned int> glyphs;
+  for (unsigned int i = 0; i < count; i++)
+    if (font->glyph_cache->find (glyph_indices[i]) == font->glyph_cache->end ())
+      glyphs.push_back (glyph_indices[i]);
+  std::sort (glyphs.begin (), glyphs.end ());
+  glyphs.erase (std::unique (glyphs.begin (), glyphs.end ()), glyphs.end ());
+
+  std::vector<glyphy_glyph_blob_t> blobs (glyphs.size ());
+  unsigned int upem = hb_face_get_upem (font->face);
+
+  /* Encode as many glyphs as fit in the scratch buffer, then upload
+   * them to the atlas in one go. */
+  for (unsigned int done = 0; done < glyphs.size ();)
+  {
+    unsigned int output_len;
+    unsigned int n = glyphy_harfbuzz(font_encode_glyphs) (font->font, font->g,
+                                                          &glyphs[done], glyphs.size () - done,
+                                                          font->scratch_buffer->data (),
+                                                          font->scratch_buffer->size (),
+                                                          &output_len,
+                                                          &blobs[done]);
+    unsigned int atlas_offset = 0;
+    if (output_len)
+      atlas_offset = demo_atlas_alloc (font->atlas,
+                                       font->scratch_buffer->data (),
+                                       output_len);
+
+    for (unsigned int i = done; i < done + n; i++) {
+      glyph_info_t glyph_info;
+
+      glyph_info.extents = blobs[i].extents;
+      glyph_info.advance = hb_font_get_glyph_h_advance (font->font, glyphs[i]);
+      glyph_info.upem = upem;
+      glyph_info.is_empty = glyphy_extents_is_empty (&glyph_info.extents);
+      glyph_info.atlas_offset = glyph_info.is_empty ? 0 : atlas_offset + blobs[i].offset;
+      (*font->glyph_cache)[glyphs[i]] = glyph_info;
+
+      font->num_glyphs++;
+      font->sum_curves += blobs[i].num_curves;
+      font->sum_bytes += blobs[i].length * sizeof (glyphy_texel_t);
+    }
+
+    done += n;
+    if (done == glyphs.size ())
+      break;
+
+    /* The next glyph did not fit in what was left of the buffer.  It is
+     * still drawn into font->g, so ask for its exact size and grow the
+     * buffer if even an empty one is too small.  Glyphs that do not fit
+     * in one blob at all are split into tiles. */
+    unsigned int len;
+    if (!glyphy_successful (font->g))
+      die ("Failed encoding blob");
+    if (!glyphy_encode_size (font->g, &len)) {
+      encode_tiles (font, glyphs[done]);
+      done++;
+      continue;
+    }
+    if (!n && len <= font->scratch_buffer->size ())
+      die ("Failed encoding blob");
+    if (len > font->scratch_buffer->size ())
+      font->scratch_buffer->resize (len);
+  }
 }
 
 void
@@ -126,11 +198,8 @@ demo_font_lookup_glyph (demo_font_t  *font,
                         unsigned int  glyph_index,
                         glyph_info_t *glyph_info)
 {
-  if (font->glyph_cache->find (glyph_index) == font->glyph_cache->end ()) {
-    _demo_font_upload_glyph (font, glyph_index, glyph_info);
-    (*font->glyph_cache)[glyph_index] = *glyph_info;
-  } else
-    *glyph_info = (*font->glyph_cache)[glyph_index];
+  demo_font_prefetch_glyphs (font, &glyph_index, 1);
+  *glyph_info = (*font->glyph_cache)[glyph_index];
 }
 
 void
@@ -17,6 +17,8 @@ typedef struct {
   glyphy_bool_t    is_empty;
   unsigned int     upem;
   unsigned int     atlas_offset;
+  /* Glyphs too large for one blob; offsets are atlas offsets */
+  std::vector<glyphy_tile_t> tiles;
 } glyph_info_t;
 
 
@@ -37,6 +39,12 @@ hb_font_t *
 demo_font_get_font (demo_font_t *font);
 
 
+/* Encodes and uploads all glyphs not yet in the atlas, in batches. */
+void
+demo_font_prefetch_glyphs (demo_font_t        *font,
+                           const unsigned int *glyph_indices,
+                           unsigned int        count);
+
 void
 demo_font_lookup_glyph (demo_font_t  *font,
                         unsigned int  glyph_index,
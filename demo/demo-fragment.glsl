@@ -1,11 +1,17 @@
 in vec2 v_texcoord;
 flat in uint v_glyphLoc;
+flat in vec4 v_ext;
+flat in vec4 v_bandTransform;
+flat in ivec4 v_header;
+flat in float v_singleAxisPpem;
 
 out vec4 fragColor;
 
 void main ()
 {
-  float coverage = glyphy_render (v_texcoord, v_glyphLoc);
+  float coverage = glyphy_render (v_texcoord, v_glyphLoc,
+				  v_ext, v_bandTransform, v_header,
+				  v_singleAxisPpem);
 
   fragColor = vec4 (0.0, 0.0, 0.0, coverage);
 }
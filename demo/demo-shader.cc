@@ -12,40 +12,46 @@
 #include "demo-vertex-glsl.h"
 #include "demo-fragment-glsl.h"
 
-
-void
-demo_shader_add_glyph_vertices (const glyphy_point_t        &p,
-                                double                       font_size,
-                                glyph_info_t                *gi,
-                                std::vector<glyph_vertex_t> *vertices,
-                                glyphy_extents_t            *extents)
+/* Size, in pixels per em, from which glyphs cast rays along one axis
+ * only; see glyphy_render(). */
+#define DEMO_SINGLE_AXIS_PPEM 256.
+
+
+/* Adds a quad over extents, sampling the blob at atlas_offset at em
+ * coordinates minus origin.  Only the sides of extents on the sides of
+ * glyph_extents are dilated. */
+static void
+add_quad (const glyphy_point_t        &p,
+          double                       scale,
+          const glyphy_extents_t      &extents,
+          const glyphy_extents_t      &glyph_extents,
+          const glyphy_point_t        &origin,
+          unsigned int                 atlas_offset,
+          double                       single_axis_ppem,
+          std::vector<glyph_vertex_t> *vertices)
 {
-  if (gi->is_empty)
-    return;
-
-  /* Extents and texcoords are in font design units.
-   * Screen position uses font_size / upem as the scale. */
-  double scale = font_size / gi->upem;
-
   glyph_vertex_t v[4];
 
   for (int ci = 0; ci < 4; ci++) {
     int cx = (ci >> 1) & 1;
     int cy = ci & 1;
 
-    double ex = (1 - cx) * gi->extents.min_x + cx * gi->extents.max_x;
-    double ey = (1 - cy) * gi->extents.min_y + cy * gi->extents.max_y;
+    double ex = (1 - cx) * extents.min_x + cx * extents.max_x;
+    double ey = (1 - cy) * extents.min_y + cy * extents.max_y;
 
     v[ci].x = (float) (p.x + scale * ex);
     v[ci].y = (float) (p.y - scale * ey);
-    v[ci].tx = (float) ex;
-    v[ci].ty = (float) ey;
+    v[ci].tx = (float) (ex - origin.x);
+    v[ci].ty = (float) (ey - origin.y);
     /* Object-space outward normal.  The em-to-object transform flips y
      * (obj_y = p.y - scale * em_y), so ny is opposite to em-space. */
-    v[ci].nx = cx ? 1.f : -1.f;
-    v[ci].ny = cy ? -1.f : 1.f;
+    bool outer_x = cx ? extents.max_x == glyph_extents.max_x : extents.min_x == glyph_extents.min_x;
+    bool outer_y = cy ? extents.max_y == glyph_extents.max_y : extents.min_y == glyph_extents.min_y;
+    v[ci].nx = outer_x ? (cx ? 1.f : -1.f) : 0.f;
+    v[ci].ny = outer_y ? (cy ? -1.f : 1.f) : 0.f;
     v[ci].emPerPos = (float) (1.0 / scale);
-    v[ci].atlas_offset = gi->atlas_offset;
+    v[ci].singleAxisPpem = (float) single_axis_ppem;
+    v[ci].atlas_offset = atlas_offset;
   }
 
   /* Two triangles */
@@ -56,11 +62,38 @@ demo_shader_add_glyph_vertices (const glyphy_point_t        &p,
   vertices->push_back (v[1]);
   vertices->push_back (v[2]);
   vertices->push_back (v[3]);
+}
+
+void
+demo_shader_add_glyph_vertices (const glyphy_point_t        &p,
+                                double                       font_size,
+                                glyph_info_t                *gi,
+                                std::vector<glyph_vertex_t> *vertices,
+                                glyphy_extents_t            *extents)
+{
+  if (gi->is_empty)
+    return;
+
+  /* Extents and texcoords are in font design units.
+   * Screen position uses font_size / upem as the scale. */
+  double scale = font_size / gi->upem;
+  double single_axis_ppem = DEMO_SINGLE_AXIS_PPEM / gi->upem;
+
+  glyphy_point_t no_origin = {0, 0};
+  if (gi->tiles.empty ())
+    add_quad (p, scale, gi->extents, gi->extents, no_origin, gi->atlas_offset,
+              single_axis_ppem, vertices);
+  else
+    for (const glyphy_tile_t &tile : gi->tiles)
+      add_quad (p, scale, tile.extents, gi->extents, tile.origin, tile.offset,
+                single_axis_ppem, vertices);
 
   if (extents) {
     glyphy_extents_clear (extents);
     for (int i = 0; i < 4; i++) {
-      glyphy_point_t pt = {v[i].x, v[i].y};
+      double ex = i & 1 ? gi->extents.max_x : gi->extents.min_x;
+      double ey = i & 2 ? gi->extents.max_y : gi->extents.min_y;
+      glyphy_point_t pt = {(float) (p.x + scale * ex), (float) (p.y - scale * ey)};
       glyphy_extents_add (extents, &pt);
     }
   }
@@ -22,6 +22,8 @@ struct glyph_vertex_t {
   GLfloat ny;
   /* Em units per object-space unit (upem / font_size) */
   GLfloat emPerPos;
+  /* Pixels per em unit from which to cast rays along one axis only */
+  GLfloat singleAxisPpem;
   /* Atlas offset (constant across glyph) */
   GLuint atlas_offset;
 };
@@ -5,10 +5,15 @@ in vec2 a_position;
 in vec2 a_texcoord;
 in vec2 a_normal;
 in float a_emPerPos;
+in float a_singleAxisPpem;
 in uint a_glyphLoc;
 
 out vec2 v_texcoord;
 flat out uint v_glyphLoc;
+flat out vec4 v_ext;
+flat out vec4 v_bandTransform;
+flat out ivec4 v_header;
+flat out float v_singleAxisPpem;
 
 void main ()
 {
@@ -23,4 +28,6 @@ void main ()
   gl_Position = u_matViewProjection * vec4 (pos, 0.0, 1.0);
   v_texcoord = tex;
   v_glyphLoc = a_glyphLoc;
+  glyphy_decode_header (a_glyphLoc, v_ext, v_bandTransform, v_header);
+  v_singleAxisPpem = a_singleAxisPpem;
 }
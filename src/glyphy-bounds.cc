@@ -0,0 +1,460 @@
+/*
+ * Copyright 2026 Behdad Esfahbod. All Rights Reserved.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "glyphy.h"
+#include "glyphy.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined (__AVX2__)
+# define GLYPHY_BOUNDS_AVX2 1
+# include <immintrin.h>
+#elif defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+# define GLYPHY_BOUNDS_SSE2 1
+# include <emmintrin.h>
+#endif
+
+
+/*
+ * Curve bounds, in one sweep over the curve arrays.
+ *
+ * For each curve: min/max in x and y, the same quantized, and whether it
+ * is horizontal or vertical; and the extents of all curves.  The vector
+ * paths handle four (AVX2) or two (SSE2) curves per step, picked at
+ * compile time; the scalar code does the rest.  All paths give the same
+ * results, including quantization, which rounds halfway cases away from
+ * zero like round().
+ *
+ * Fixed-point curves (GLYPHY_FLAG_FIXED_POINT) are already quantized;
+ * their bounds are integer min/max, eight curves per SSE2 step.
+ *
+ * Cubics (GLYPHY_FLAG_NATIVE_CUBICS) go through the same paths for
+ * their ends and first control point; a second, scalar pass then takes
+ * in their second control point.
+ */
+
+
+static inline void
+set_info (glyphy_curve_info_t *info,
+          double min_x, double max_x, double min_y, double max_y,
+          int16_t qmin_x, int16_t qmax_x, int16_t qmin_y, int16_t qmax_y,
+          bool is_horizontal, bool is_vertical)
+{
+  info->min_x = min_x;
+  info->max_x = max_x;
+  info->min_y = min_y;
+  info->max_y = max_y;
+  info->qmin_x = qmin_x;
+  info->qmax_x = qmax_x;
+  info->qmin_y = qmin_y;
+  info->qmax_y = qmax_y;
+  info->is_horizontal = is_horizontal;
+  info->is_vertical = is_vertical;
+  info->hband_lo = 0;
+  info->hband_hi = -1;
+  info->vband_lo = 0;
+  info->vband_hi = -1;
+}
+
+#ifdef GLYPHY_BOUNDS_AVX2
+
+/* round (v * GLYPHY_UNITS_PER_EM_UNIT) */
+static inline __m256d
+quantize_avx2 (__m256d v)
+{
+  const __m256d half = _mm256_set1_pd (0.5);
+  const __m256d one = _mm256_set1_pd (1.0);
+  __m256d x = _mm256_mul_pd (v, _mm256_set1_pd (GLYPHY_UNITS_PER_EM_UNIT));
+  __m256d t = _mm256_round_pd (x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+  __m256d d = _mm256_sub_pd (x, t);
+  t = _mm256_add_pd (t, _mm256_and_pd (_mm256_cmp_pd (d, half, _CMP_GE_OQ), one));
+  t = _mm256_sub_pd (t, _mm256_and_pd (_mm256_cmp_pd (d, _mm256_sub_pd (_mm256_setzero_pd (), half), _CMP_LE_OQ), one));
+  return t;
+}
+
+static unsigned int
+compute_bounds_avx2 (const glyphy_curves_t &curves,
+                     glyphy_curve_info_t   *infos,
+                     double                *ext)
+{
+  unsigned int num_curves = curves.size ();
+  __m256d ext_min_x = _mm256_set1_pd (ext[0]);
+  __m256d ext_min_y = _mm256_set1_pd (ext[1]);
+  __m256d ext_max_x = _mm256_set1_pd (ext[2]);
+  __m256d ext_max_y = _mm256_set1_pd (ext[3]);
+  unsigned int i = 0;
+
+  for (; i + 4 <= num_curves; i += 4) {
+    __m256d x1 = _mm256_loadu_pd (&curves.x1[i]);
+    __m256d y1 = _mm256_loadu_pd (&curves.y1[i]);
+    __m256d x2 = _mm256_loadu_pd (&curves.x2[i]);
+    __m256d y2 = _mm256_loadu_pd (&curves.y2[i]);
+    __m256d x3 = _mm256_loadu_pd (&curves.x3[i]);
+    __m256d y3 = _mm256_loadu_pd (&curves.y3[i]);
+
+    __m256d min_x = _mm256_min_pd (_mm256_min_pd (x1, x2), x3);
+    __m256d max_x = _mm256_max_pd (_mm256_max_pd (x1, x2), x3);
+    __m256d min_y = _mm256_min_pd (_mm256_min_pd (y1, y2), y3);
+    __m256d max_y = _mm256_max_pd (_mm256_max_pd (y1, y2), y3);
+
+    ext_min_x = _mm256_min_pd (ext_min_x, min_x);
+    ext_max_x = _mm256_max_pd (ext_max_x, max_x);
+    ext_min_y = _mm256_min_pd (ext_min_y, min_y);
+    ext_max_y = _mm256_max_pd (ext_max_y, max_y);
+
+    int horizontal = _mm256_movemask_pd (_mm256_and_pd (_mm256_cmp_pd (y1, y2, _CMP_EQ_OQ),
+                                                        _mm256_cmp_pd (y2, y3, _CMP_EQ_OQ)));
+    int vertical = _mm256_movemask_pd (_mm256_and_pd (_mm256_cmp_pd (x1, x2, _CMP_EQ_OQ),
+                                                      _mm256_cmp_pd (x2, x3, _CMP_EQ_OQ)));
+
+    double b[4][4], q[4][4];
+    _mm256_storeu_pd (b[0], min_x);
+    _mm256_storeu_pd (b[1], max_x);
+    _mm256_storeu_pd (b[2], min_y);
+    _mm256_storeu_pd (b[3], max_y);
+    _mm256_storeu_pd (q[0], quantize_avx2 (min_x));
+    _mm256_storeu_pd (q[1], quantize_avx2 (max_x));
+    _mm256_storeu_pd (q[2], quantize_avx2 (min_y));
+    _mm256_storeu_pd (q[3], quantize_avx2 (max_y));
+
+    for (unsigned int k = 0; k < 4; k++)
+      set_info (&infos[i + k],
+                b[0][k], b[1][k], b[2][k], b[3][k],
+                (int16_t) q[0][k], (int16_t) q[1][k], (int16_t) q[2][k], (int16_t) q[3][k],
+                horizontal & (1 << k), vertical & (1 << k));
+  }
+
+  double e[4][4];
+  _mm256_storeu_pd (e[0], ext_min_x);
+  _mm256_storeu_pd (e[1], ext_min_y);
+  _mm256_storeu_pd (e[2], ext_max_x);
+  _mm256_storeu_pd (e[3], ext_max_y);
+  for (unsigned int k = 0; k < 4; k++) {
+    ext[0] = std::min (ext[0], e[0][k]);
+    ext[1] = std::min (ext[1], e[1][k]);
+    ext[2] = std::max (ext[2], e[2][k]);
+    ext[3] = std::max (ext[3], e[3][k]);
+  }
+
+  return i;
+}
+
+#endif /* GLYPHY_BOUNDS_AVX2 */
+
+#ifdef GLYPHY_BOUNDS_SSE2
+
+/* round (v * GLYPHY_UNITS_PER_EM_UNIT); SSE2 has no rounding
+ * instruction, so truncate through int32.  Values out of int32 range
+ * come out wrong, but so do their int16 casts, and such curves never
+ * make it into a blob: the extents check rejects them. */
+static inline __m128d
+quantize_sse2 (__m128d v)
+{
+  const __m128d half = _mm_set1_pd (0.5);
+  const __m128d one = _mm_set1_pd (1.0);
+  __m128d x = _mm_mul_pd (v, _mm_set1_pd (GLYPHY_UNITS_PER_EM_UNIT));
+  __m128d t = _mm_cvtepi32_pd (_mm_cvttpd_epi32 (x));
+  __m128d d = _mm_sub_pd (x, t);
+  t = _mm_add_pd (t, _mm_and_pd (_mm_cmpge_pd (d, half), one));
+  t = _mm_sub_pd (t, _mm_and_pd (_mm_cmple_pd (d, _mm_sub_pd (_mm_setzero_pd (), half)), one));
+  return t;
+}
+
+static unsigned int
+compute_bounds_sse2 (const glyphy_curves_t &curves,
+                     glyphy_curve_info_t   *infos,
+                     double                *ext)
+{
+  unsigned int num_curves = curves.size ();
+  __m128d ext_min_x = _mm_set1_pd (ext[0]);
+  __m128d ext_min_y = _mm_set1_pd (ext[1]);
+  __m128d ext_max_x = _mm_set1_pd (ext[2]);
+  __m128d ext_max_y = _mm_set1_pd (ext[3]);
+  unsigned int i = 0;
+
+  for (; i + 2 <= num_curves; i += 2) {
+    __m128d x1 = _mm_loadu_pd (&curves.x1[i]);
+    __m128d y1 = _mm_loadu_pd (&curves.y1[i]);
+    __m128d x2 = _mm_loadu_pd (&curves.x2[i]);
+    __m128d y2 = _mm_loadu_pd (&curves.y2[i]);
+    __m128d x3 = _mm_loadu_pd (&curves.x3[i]);
+    __m128d y3 = _mm_loadu_pd (&curves.y3[i]);
+
+    __m128d min_x = _mm_min_pd (_mm_min_pd (x1, x2), x3);
+    __m128d max_x = _mm_max_pd (_mm_max_pd (x1, x2), x3);
+    __m128d min_y = _mm_min_pd (_mm_min_pd (y1, y2), y3);
+    __m128d max_y = _mm_max_pd (_mm_max_pd (y1, y2), y3);
+
+    ext_min_x = _mm_min_pd (ext_min_x, min_x);
+    ext_max_x = _mm_max_pd (ext_max_x, max_x);
+    ext_min_y = _mm_min_pd (ext_min_y, min_y);
+    ext_max_y = _mm_max_pd (ext_max_y, max_y);
+
+    int horizontal = _mm_movemask_pd (_mm_and_pd (_mm_cmpeq_pd (y1, y2), _mm_cmpeq_pd (y2, y3)));
+    int vertical = _mm_movemask_pd (_mm_and_pd (_mm_cmpeq_pd (x1, x2), _mm_cmpeq_pd (x2, x3)));
+
+    double b[4][2], q[4][2];
+    _mm_storeu_pd (b[0], min_x);
+    _mm_storeu_pd (b[1], max_x);
+    _mm_storeu_pd (b[2], min_y);
+    _mm_storeu_pd (b[3], max_y);
+    _mm_storeu_pd (q[0], quantize_sse2 (min_x));
+    _mm_storeu_pd (q[1], quantize_sse2 (max_x));
+    _mm_storeu_pd (q[2], quantize_sse2 (min_y));
+    _mm_storeu_pd (q[3], quantize_sse2 (max_y));
+
+    for (unsigned int k = 0; k < 2; k++)
+      set_info (&infos[i + k],
+                b[0][k], b[1][k], b[2][k], b[3][k],
+                (int16_t) q[0][k], (int16_t) q[1][k], (int16_t) q[2][k], (int16_t) q[3][k],
+                horizontal & (1 << k), vertical & (1 << k));
+  }
+
+  double e[4][2];
+  _mm_storeu_pd (e[0], ext_min_x);
+  _mm_storeu_pd (e[1], ext_min_y);
+  _mm_storeu_pd (e[2], ext_max_x);
+  _mm_storeu_pd (e[3], ext_max_y);
+  for (unsigned int k = 0; k < 2; k++) {
+    ext[0] = std::min (ext[0], e[0][k]);
+    ext[1] = std::min (ext[1], e[1][k]);
+    ext[2] = std::max (ext[2], e[2][k]);
+    ext[3] = std::max (ext[3], e[3][k]);
+  }
+
+  return i;
+}
+
+#endif /* GLYPHY_BOUNDS_SSE2 */
+
+#if defined (GLYPHY_BOUNDS_AVX2) || defined (GLYPHY_BOUNDS_SSE2)
+
+static unsigned int
+compute_fixed_bounds_sse2 (const glyphy_curves_t &curves,
+                           glyphy_curve_info_t   *infos,
+                           int16_t               *ext)
+{
+  unsigned int num_curves = curves.size ();
+  unsigned int i = 0;
+
+  __m128i ext_min_x = _mm_set1_epi16 (ext[0]);
+  __m128i ext_min_y = _mm_set1_epi16 (ext[1]);
+  __m128i ext_max_x = _mm_set1_epi16 (ext[2]);
+  __m128i ext_max_y = _mm_set1_epi16 (ext[3]);
+
+  for (; i + 8 <= num_curves; i += 8) {
+    __m128i x1 = _mm_loadu_si128 ((const __m128i *) &curves.qx1[i]);
+    __m128i y1 = _mm_loadu_si128 ((const __m128i *) &curves.qy1[i]);
+    __m128i x2 = _mm_loadu_si128 ((const __m128i *) &curves.qx2[i]);
+    __m128i y2 = _mm_loadu_si128 ((const __m128i *) &curves.qy2[i]);
+    __m128i x3 = _mm_loadu_si128 ((const __m128i *) &curves.qx3[i]);
+    __m128i y3 = _mm_loadu_si128 ((const __m128i *) &curves.qy3[i]);
+
+    __m128i min_x = _mm_min_epi16 (_mm_min_epi16 (x1, x2), x3);
+    __m128i max_x = _mm_max_epi16 (_mm_max_epi16 (x1, x2), x3);
+    __m128i min_y = _mm_min_epi16 (_mm_min_epi16 (y1, y2), y3);
+    __m128i max_y = _mm_max_epi16 (_mm_max_epi16 (y1, y2), y3);
+
+    ext_min_x = _mm_min_epi16 (ext_min_x, min_x);
+    ext_min_y = _mm_min_epi16 (ext_min_y, min_y);
+    ext_max_x = _mm_max_epi16 (ext_max_x, max_x);
+    ext_max_y = _mm_max_epi16 (ext_max_y, max_y);
+
+    /* A flat curve has min == max on that axis. */
+    int horizontal = _mm_movemask_epi8 (_mm_cmpeq_epi16 (min_y, max_y));
+    int vertical = _mm_movemask_epi8 (_mm_cmpeq_epi16 (min_x, max_x));
+
+    int16_t mins_x[8], maxs_x[8], mins_y[8], maxs_y[8];
+    _mm_storeu_si128 ((__m128i *) mins_x, min_x);
+    _mm_storeu_si128 ((__m128i *) maxs_x, max_x);
+    _mm_storeu_si128 ((__m128i *) mins_y, min_y);
+    _mm_storeu_si128 ((__m128i *) maxs_y, max_y);
+
+    for (unsigned int k = 0; k < 8; k++)
+      set_info (&infos[i + k],
+                glyphy_dequantize (mins_x[k]), glyphy_dequantize (maxs_x[k]),
+                glyphy_dequantize (mins_y[k]), glyphy_dequantize (maxs_y[k]),
+                mins_x[k], maxs_x[k], mins_y[k], maxs_y[k],
+                (horizontal >> (2 * k)) & 1,
+                (vertical >> (2 * k)) & 1);
+  }
+
+  int16_t lanes[8];
+  _mm_storeu_si128 ((__m128i *) lanes, ext_min_x);
+  ext[0] = *std::min_element (lanes, lanes + 8);
+  _mm_storeu_si128 ((__m128i *) lanes, ext_min_y);
+  ext[1] = *std::min_element (lanes, lanes + 8);
+  _mm_storeu_si128 ((__m128i *) lanes, ext_max_x);
+  ext[2] = *std::max_element (lanes, lanes + 8);
+  _mm_storeu_si128 ((__m128i *) lanes, ext_max_y);
+  ext[3] = *std::max_element (lanes, lanes + 8);
+
+  return i;
+}
+
+#endif
+
+static void
+compute_fixed_bounds (const glyphy_curves_t &curves,
+                      glyphy_curve_info_t   *infos,
+                      glyphy_extents_t      *extents)
+{
+  unsigned int num_curves = curves.size ();
+
+  /* min_x, min_y, max_x, max_y */
+  int16_t ext[4] = {
+    std::numeric_limits<int16_t>::max (),
+    std::numeric_limits<int16_t>::max (),
+    std::numeric_limits<int16_t>::min (),
+    std::numeric_limits<int16_t>::min (),
+  };
+  unsigned int i = 0;
+
+#if defined (GLYPHY_BOUNDS_AVX2) || defined (GLYPHY_BOUNDS_SSE2)
+  i = compute_fixed_bounds_sse2 (curves, infos, ext);
+#endif
+
+  for (; i < num_curves; i++) {
+    int16_t x1 = curves.qx1[i], y1 = curves.qy1[i];
+    int16_t x2 = curves.qx2[i], y2 = curves.qy2[i];
+    int16_t x3 = curves.qx3[i], y3 = curves.qy3[i];
+
+    int16_t min_x = std::min (std::min (x1, x2), x3);
+    int16_t max_x = std::max (std::max (x1, x2), x3);
+    int16_t min_y = std::min (std::min (y1, y2), y3);
+    int16_t max_y = std::max (std::max (y1, y2), y3);
+
+    ext[0] = std::min (ext[0], min_x);
+    ext[1] = std::min (ext[1], min_y);
+    ext[2] = std::max (ext[2], max_x);
+    ext[3] = std::max (ext[3], max_y);
+
+    set_info (&infos[i],
+              glyphy_dequantize (min_x), glyphy_dequantize (max_x),
+              glyphy_dequantize (min_y), glyphy_dequantize (max_y),
+              min_x, max_x, min_y, max_y,
+              min_y == max_y,
+              min_x == max_x);
+  }
+
+  extents->min_x = glyphy_dequantize (ext[0]);
+  extents->min_y = glyphy_dequantize (ext[1]);
+  extents->max_x = glyphy_dequantize (ext[2]);
+  extents->max_y = glyphy_dequantize (ext[3]);
+}
+
+/* Widen bounds and extents to take in the cubics' second control
+ * points. */
+static void
+add_cubic_controls (const glyphy_curves_t &curves,
+                    glyphy_curve_info_t   *infos,
+                    glyphy_extents_t      *extents)
+{
+  unsigned int num_curves = curves.size ();
+
+  for (unsigned int i = 0; i < num_curves; i++) {
+    glyphy_curve_info_t &info = infos[i];
+    double x, y;
+    int16_t qx, qy;
+    if (curves.fixed) {
+      qx = curves.qxc[i];
+      qy = curves.qyc[i];
+      x = glyphy_dequantize (qx);
+      y = glyphy_dequantize (qy);
+    } else {
+      x = curves.xc[i];
+      y = curves.yc[i];
+      qx = glyphy_quantize (x);
+      qy = glyphy_quantize (y);
+    }
+
+    info.is_horizontal = info.is_horizontal && y == info.min_y;
+    info.is_vertical = info.is_vertical && x == info.min_x;
+    info.min_x = std::min (info.min_x, x);
+    info.max_x = std::max (info.max_x, x);
+    info.min_y = std::min (info.min_y, y);
+    info.max_y = std::max (info.max_y, y);
+    info.qmin_x = std::min (info.qmin_x, qx);
+    info.qmax_x = std::max (info.qmax_x, qx);
+    info.qmin_y = std::min (info.qmin_y, qy);
+    info.qmax_y = std::max (info.qmax_y, qy);
+
+    extents->min_x = std::min (extents->min_x, x);
+    extents->max_x = std::max (extents->max_x, x);
+    extents->min_y = std::min (extents->min_y, y);
+    extents->max_y = std::max (extents->max_y, y);
+  }
+}
+
+void
+glyphy_compute_curve_bounds (const glyphy_curves_t &curves,
+                             glyphy_curve_info_t   *infos,
+                             glyphy_extents_t      *extents)
+{
+  unsigned int num_curves = curves.size ();
+  if (!num_curves) {
+    glyphy_extents_clear (extents);
+    return;
+  }
+
+  if (curves.fixed) {
+    compute_fixed_bounds (curves, infos, extents);
+    if (curves.cubic)
+      add_cubic_controls (curves, infos, extents);
+    return;
+  }
+
+  /* min_x, min_y, max_x, max_y */
+  double ext[4] = {
+    std::numeric_limits<double>::infinity (),
+    std::numeric_limits<double>::infinity (),
+    -std::numeric_limits<double>::infinity (),
+    -std::numeric_limits<double>::infinity (),
+  };
+  unsigned int i = 0;
+
+#if defined (GLYPHY_BOUNDS_AVX2)
+  i = compute_bounds_avx2 (curves, infos, ext);
+#elif defined (GLYPHY_BOUNDS_SSE2)
+  i = compute_bounds_sse2 (curves, infos, ext);
+#endif
+
+  for (; i < num_curves; i++) {
+    double x1 = curves.x1[i], y1 = curves.y1[i];
+    double x2 = curves.x2[i], y2 = curves.y2[i];
+    double x3 = curves.x3[i], y3 = curves.y3[i];
+
+    double min_x = std::min (std::min (x1, x2), x3);
+    double max_x = std::max (std::max (x1, x2), x3);
+    double min_y = std::min (std::min (y1, y2), y3);
+    double max_y = std::max (std::max (y1, y2), y3);
+
+    ext[0] = std::min (ext[0], min_x);
+    ext[1] = std::min (ext[1], min_y);
+    ext[2] = std::max (ext[2], max_x);
+    ext[3] = std::max (ext[3], max_y);
+
+    set_info (&infos[i],
+              min_x, max_x, min_y, max_y,
+              glyphy_quantize (min_x), glyphy_quantize (max_x),
+              glyphy_quantize (min_y), glyphy_quantize (max_y),
+              y1 == y2 && y2 == y3,
+              x1 == x2 && x2 == x3);
+  }
+
+  extents->min_x = ext[0];
+  extents->min_y = ext[1];
+  extents->max_x = ext[2];
+  extents->max_y = ext[3];
+
+  if (curves.cubic)
+    add_cubic_controls (curves, infos, extents);
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2026 Behdad Esfahbod. All Rights Reserved.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "glyphy.h"
+#include "glyphy.hh"
+
+#include <algorithm>
+#include <cmath>
+
+
+/*
+ * Cell grid (GLYPHY_FLAG_CELL_GRID).
+ *
+ * A GLYPHY_CELL_GRID_SIZE square grid over the quantized extents.  A
+ * cell that no curve's quantized control box touches is solid or empty
+ * throughout, as the winding number at its center says; the others
+ * are edge cells.  Runs of such cells along a row share the winding
+ * number, since a curve between two of them would touch both.
+ *
+ * Everything is in blob units, on the curves as encoded, so the cells
+ * agree with what the shader would compute from the curves.
+ */
+
+
+/* Range of cells along one axis whose closed spans meet [lo, hi]. */
+static inline void
+cell_range (double lo, double hi,
+            double origin, double scale,
+            int *first, int *last)
+{
+  const int n = GLYPHY_CELL_GRID_SIZE;
+  *first = std::max ((int) ceil ((lo - origin) * scale) - 1, 0);
+  *last = std::min ((int) floor ((hi - origin) * scale), n - 1);
+}
+
+bool
+glyphy_classify_cells (const glyphy_curves_t     &curves,
+                       const glyphy_curve_info_t *infos,
+                       const glyphy_extents_t    &extents,
+                       glyphy_cells_scratch_t    &scratch)
+{
+  const int n = GLYPHY_CELL_GRID_SIZE;
+  double min_x = glyphy_quantize (extents.min_x);
+  double min_y = glyphy_quantize (extents.min_y);
+  double width = glyphy_quantize (extents.max_x) - min_x;
+  double height = glyphy_quantize (extents.max_y) - min_y;
+  if (!(width > 0 && height > 0))
+    return false;
+  double scale_x = n / width;
+  double scale_y = n / height;
+
+  std::vector<uint8_t> &cells = scratch.cells;
+  cells.assign (n * n, GLYPHY_CELL_EMPTY);
+
+  unsigned int num_curves = curves.size ();
+  unsigned int order = curves.cubic ? 4 : 3;
+  scratch.points.resize (4 * num_curves);
+  scratch.boxes.resize (4 * num_curves);
+  for (unsigned int i = 0; i < num_curves; i++) {
+    const glyphy_curve_info_t &info = infos[i];
+    double *box = &scratch.boxes[4 * i];
+    box[0] = info.qmin_x;
+    box[1] = info.qmin_y;
+    box[2] = info.qmax_x;
+    box[3] = info.qmax_y;
+
+    glyphy_get_blob_points (curves, i, &scratch.points[4 * i]);
+
+    int x0, x1, y0, y1;
+    cell_range (box[0], box[2], min_x, scale_x, &x0, &x1);
+    cell_range (box[1], box[3], min_y, scale_y, &y0, &y1);
+    for (int y = y0; y <= y1; y++)
+      for (int x = x0; x <= x1; x++)
+        cells[y * n + x] = GLYPHY_CELL_EDGE;
+  }
+
+  bool any = false;
+  for (int y = 0; y < n; y++) {
+    int w = 0;
+    bool known = false;
+    for (int x = 0; x < n; x++) {
+      uint8_t &cell = cells[y * n + x];
+      if (cell == GLYPHY_CELL_EDGE) {
+        known = false;
+        continue;
+      }
+      if (!known) {
+        glyphy_point_t center = {min_x + (x + .5) / scale_x,
+                                 min_y + (y + .5) / scale_y};
+        w = glyphy_winding_number (scratch.points.data (), scratch.boxes.data (),
+                                   num_curves, order, center);
+        known = true;
+      }
+      cell = w ? GLYPHY_CELL_SOLID : GLYPHY_CELL_EMPTY;
+      any = true;
+    }
+  }
+  return any;
+}
@@ -11,21 +11,27 @@
 #endif
 
 #include "glyphy.h"
+#include "glyphy.hh"
 
 #include <cmath>
 
-
-/* Maximum approximation error in font units.
- * 0.5 is well below one unit in any reasonable coordinate system. */
-#ifndef GLYPHY_CU2QU_TOLERANCE
-#define GLYPHY_CU2QU_TOLERANCE 0.5
+#if defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+# define GLYPHY_CU2QU_SSE2 1
+# include <emmintrin.h>
 #endif
 
+
 /* Maximum subdivision depth.  Each level halves the parameter interval;
  * at depth 10 the sub-curve spans 1/1024 of the original, so the
  * quadratic error (O(dt^4)) is reduced by a factor of ~10^12. */
 #define CU2QU_MAX_DEPTH 10
 
+/* Maximum subdivision depth when checking an error curve. */
+#define CU2QU_FIT_MAX_DEPTH 8
+
+/* Most quadratics tried in one spline before subdividing. */
+#define CU2QU_MAX_N 16
+
 
 typedef glyphy_point_t Point;
 
@@ -39,49 +45,178 @@ point_lerp (const Point &a, const Point &b, double t)
 
 
 /*
- * Check whether a cubic error curve stays within `tolerance` of the origin.
+ * Distance tests against the tolerance.  Squared distances decide away
+ * from the tolerance; near it, or where squaring overflows or
+ * underflows, hypot() decides.  The outcome is always that of comparing
+ * hypot() with the tolerance.
+ */
+
+struct tolerance_t
+{
+  double tolerance;
+  double inside2;  /* Squared distances below this are within */
+  double outside2; /* Squared distances above this are not */
+};
+
+static tolerance_t
+make_tolerance (double tolerance)
+{
+  /* Far more than the rounding error of squaring or of hypot(). */
+  const double slack = ldexp (1., -40);
+  double tolerance2 = tolerance * tolerance;
+
+  tolerance_t t;
+  t.tolerance = tolerance;
+  if (tolerance > 0 &&
+      tolerance2 >= ldexp (1., -900) && tolerance2 <= ldexp (1., 900))
+  {
+    t.inside2 = tolerance2 * (1 - slack);
+    t.outside2 = tolerance2 * (1 + slack);
+  }
+  else
+  {
+    /* Squares near the ends of the range may have underflowed or
+     * overflowed; leave those, and odd tolerances, to hypot(). */
+    t.inside2 = 0;
+    t.outside2 = INFINITY;
+  }
+  return t;
+}
+
+static inline bool
+distance_within (double x, double y, const tolerance_t &t)
+{
+  double n = x * x + y * y;
+  if (n < t.inside2)
+    return true;
+  if (n > t.outside2)
+    return false;
+  return hypot (x, y) <= t.tolerance;
+}
+
+/* Not the negation of distance_within() for NaNs. */
+static inline bool
+distance_exceeds (double x, double y, const tolerance_t &t)
+{
+  double n = x * x + y * y;
+  if (n < t.inside2)
+    return false;
+  if (n > t.outside2)
+    return true;
+  return hypot (x, y) > t.tolerance;
+}
+
+
+/*
+ * Two-lane vectors of doubles, holding a point's x and y; SSE2 when
+ * available.  The arithmetic is the same in either case, so both give
+ * bit-identical results.
+ */
+
+#ifdef GLYPHY_CU2QU_SSE2
+
+struct vec2_t { __m128d v; };
+
+static inline vec2_t v2 (Point p) { return vec2_t {_mm_set_pd (p.y, p.x)}; }
+static inline vec2_t operator + (vec2_t a, vec2_t b) { return vec2_t {_mm_add_pd (a.v, b.v)}; }
+static inline vec2_t operator - (vec2_t a, vec2_t b) { return vec2_t {_mm_sub_pd (a.v, b.v)}; }
+static inline vec2_t operator * (vec2_t a, double s) { return vec2_t {_mm_mul_pd (a.v, _mm_set1_pd (s))}; }
+
+static inline double v2_x (vec2_t a) { return _mm_cvtsd_f64 (a.v); }
+static inline double v2_y (vec2_t a) { return _mm_cvtsd_f64 (_mm_unpackhi_pd (a.v, a.v)); }
+
+/* Whether a and b are both within the tolerance, squaring both in one
+ * go. */
+static inline bool
+v2_both_within (vec2_t a, vec2_t b, const tolerance_t &t)
+{
+  __m128d x = _mm_unpacklo_pd (a.v, b.v);
+  __m128d y = _mm_unpackhi_pd (a.v, b.v);
+  __m128d n = _mm_add_pd (_mm_mul_pd (x, x), _mm_mul_pd (y, y));
+  if (_mm_movemask_pd (_mm_cmplt_pd (n, _mm_set1_pd (t.inside2))) == 3)
+    return true;
+  if (_mm_movemask_pd (_mm_cmpgt_pd (n, _mm_set1_pd (t.outside2))))
+    return false;
+  return distance_within (v2_x (a), v2_y (a), t) &&
+	 distance_within (v2_x (b), v2_y (b), t);
+}
+
+#else
+
+struct vec2_t { double x, y; };
+
+static inline vec2_t v2 (Point p) { return vec2_t {p.x, p.y}; }
+static inline vec2_t operator + (vec2_t a, vec2_t b) { return vec2_t {a.x + b.x, a.y + b.y}; }
+static inline vec2_t operator - (vec2_t a, vec2_t b) { return vec2_t {a.x - b.x, a.y - b.y}; }
+static inline vec2_t operator * (vec2_t a, double s) { return vec2_t {a.x * s, a.y * s}; }
+
+static inline double v2_x (vec2_t a) { return a.x; }
+static inline double v2_y (vec2_t a) { return a.y; }
+
+static inline bool
+v2_both_within (vec2_t a, vec2_t b, const tolerance_t &t)
+{
+  return distance_within (a.x, a.y, t) && distance_within (b.x, b.y, t);
+}
+
+#endif
+
+static inline bool
+v2_exceeds (vec2_t a, const tolerance_t &t)
+{
+  return distance_exceeds (v2_x (a), v2_y (a), t);
+}
+
+
+/*
+ * Check whether a cubic error curve stays within tolerance of the origin.
  *
  * Given control points (p0, p1, p2, p3) of a cubic that represents the
  * *difference* between two curves, returns true iff the curve never
- * exceeds `tolerance` distance from (0,0).
+ * exceeds the tolerance distance from (0,0).
  *
- * Uses recursive subdivision: evaluate the midpoint, and if it is
- * within tolerance, split and check each half.
+ * Subdivides at the midpoint as long as the control points stray
+ * outside the tolerance but the midpoint does not, up to
+ * CU2QU_FIT_MAX_DEPTH levels.  Halves still to check wait on a stack;
+ * both halves of a split are tested for early acceptance together.
  */
 static bool
-cubic_farthest_fit_inside (Point p0, Point p1, Point p2, Point p3,
-			   double tolerance, unsigned depth)
+cubic_farthest_fit_inside (Point p0_, Point p1_, Point p2_, Point p3_,
+			   const tolerance_t &tolerance)
 {
-  if (hypot (p1.x, p1.y) <= tolerance &&
-      hypot (p2.x, p2.y) <= tolerance)
-    return true;
+  struct pending_t { vec2_t p0, p1, p2, p3; unsigned depth; };
+  pending_t stack[CU2QU_FIT_MAX_DEPTH + 1];
+  unsigned stack_len = 0;
 
-  if (depth >= 8)
-    return false;
-
-  /* de Casteljau midpoint of the cubic */
-  Point mid = {(p0.x + 3 * (p1.x + p2.x) + p3.x) * 0.125,
-	       (p0.y + 3 * (p1.y + p2.y) + p3.y) * 0.125};
-  if (hypot (mid.x, mid.y) > tolerance)
-    return false;
+  vec2_t p0 = v2 (p0_), p1 = v2 (p1_), p2 = v2 (p2_), p3 = v2 (p3_);
+  if (v2_both_within (p1, p2, tolerance))
+    return true;
+  stack[stack_len++] = pending_t {p0, p1, p2, p3, 0};
 
-  /* Third of the derivative at the midpoint */
-  Point d3 = {(p3.x + p2.x - p1.x - p0.x) * 0.125,
-	      (p3.y + p2.y - p1.y - p0.y) * 0.125};
+  while (stack_len)
+  {
+    /* Known not to fit by its control points alone. */
+    const pending_t c = stack[--stack_len];
+    if (c.depth >= CU2QU_FIT_MAX_DEPTH)
+      return false;
+
+    /* de Casteljau midpoint of the cubic */
+    vec2_t mid = (c.p0 + (c.p1 + c.p2) * 3 + c.p3) * 0.125;
+    if (v2_exceeds (mid, tolerance))
+      return false;
+
+    /* Third of the derivative at the midpoint */
+    vec2_t d3 = (c.p3 + c.p2 - c.p1 - c.p0) * 0.125;
+
+    vec2_t l1 = c.p0 + (c.p1 - c.p0) * 0.5, l2 = mid - d3;
+    vec2_t r1 = mid + d3, r2 = c.p2 + (c.p3 - c.p2) * 0.5;
+    if (!v2_both_within (r1, r2, tolerance))
+      stack[stack_len++] = pending_t {mid, r1, r2, c.p3, c.depth + 1};
+    if (!v2_both_within (l1, l2, tolerance))
+      stack[stack_len++] = pending_t {c.p0, l1, l2, mid, c.depth + 1};
+  }
 
-  return cubic_farthest_fit_inside (
-    p0,
-    point_lerp (p0, p1, 0.5),
-    {mid.x - d3.x, mid.y - d3.y},
-    mid,
-    tolerance, depth + 1
-  ) && cubic_farthest_fit_inside (
-    mid,
-    {mid.x + d3.x, mid.y + d3.y},
-    point_lerp (p2, p3, 0.5),
-    p3,
-    tolerance, depth + 1
-  );
+  return true;
 }
 
 
@@ -90,11 +225,11 @@ cubic_farthest_fit_inside (Point p0, Point p1, Point p2, Point p3,
  *
  * The quadratic control point is placed at the intersection of the
  * tangent lines at the cubic's endpoints.  Returns true (and fills
- * *q1) if the resulting approximation stays within `tolerance`.
+ * *q1) if the resulting approximation stays within the tolerance.
  */
 static bool
 cubic_approx_quadratic (Point c0, Point c1, Point c2, Point c3,
-			double tolerance, Point *q1)
+			const tolerance_t &tolerance, Point *q1)
 {
   /* Tangent at t=0: c1 − c0,  tangent at t=1: c3 − c2 */
   double ax = c1.x - c0.x, ay = c1.y - c0.y;
@@ -124,7 +259,111 @@ cubic_approx_quadratic (Point c0, Point c1, Point c2, Point c3,
   Point err2 = {c3.x + (q1->x - c3.x) * (2.0 / 3.0) - c2.x,
 		c3.y + (q1->y - c3.y) * (2.0 / 3.0) - c2.y};
 
-  return cubic_farthest_fit_inside ({0, 0}, err1, err2, {0, 0}, tolerance, 0);
+  return cubic_farthest_fit_inside ({0, 0}, err1, err2, {0, 0}, tolerance);
+}
+
+
+/*
+ * Control point of the quadratic approximating segment t of a cubic
+ * split into n, where t = i / (n − 1): slide between the points where
+ * the start and end tangents, extended by half, land.
+ */
+static inline Point
+cubic_approx_control (double t, Point p0, Point p1, Point p2, Point p3)
+{
+  Point a = {p0.x + (p1.x - p0.x) * 1.5, p0.y + (p1.y - p0.y) * 1.5};
+  Point b = {p3.x + (p2.x - p3.x) * 1.5, p3.y + (p2.y - p3.y) * 1.5};
+  return point_lerp (a, b, t);
+}
+
+
+/*
+ * Segment i of a cubic split into n at uniform t, from its power-basis
+ * coefficients a t³ + b t² + c t + d.
+ */
+static void
+split_cubic_segment (const Point coeffs[4], unsigned i, unsigned n,
+		     Point out[4])
+{
+  const Point &a = coeffs[0], &b = coeffs[1], &c = coeffs[2], &d = coeffs[3];
+  double dt = 1.0 / n, dt2 = dt * dt, dt3 = dt2 * dt;
+  double t = i * dt, t2 = t * t;
+
+  Point a1 = {a.x * dt3, a.y * dt3};
+  Point b1 = {(3 * a.x * t + b.x) * dt2, (3 * a.y * t + b.y) * dt2};
+  Point c1 = {(2 * b.x * t + c.x + 3 * a.x * t2) * dt,
+	      (2 * b.y * t + c.y + 3 * a.y * t2) * dt};
+  Point d1 = {a.x * t * t2 + b.x * t2 + c.x * t + d.x,
+	      a.y * t * t2 + b.y * t2 + c.y * t + d.y};
+
+  out[0] = d1;
+  out[1] = {c1.x / 3 + d1.x, c1.y / 3 + d1.y};
+  out[2] = {(b1.x + c1.x) / 3 + out[1].x, (b1.y + c1.y) / 3 + out[1].y};
+  out[3] = {a1.x + d1.x + c1.x + b1.x, a1.y + d1.y + c1.y + b1.y};
+}
+
+
+/*
+ * Power-basis coefficients a t³ + b t² + c t + d of a cubic.
+ */
+static void
+cubic_coefficients (Point c0, Point c1, Point c2, Point c3, Point coeffs[4])
+{
+  coeffs[2] = {(c1.x - c0.x) * 3, (c1.y - c0.y) * 3};
+  coeffs[1] = {(c2.x - c1.x) * 3 - coeffs[2].x, (c2.y - c1.y) * 3 - coeffs[2].y};
+  coeffs[3] = c0;
+  coeffs[0] = {c3.x - c0.x - coeffs[2].x - coeffs[1].x,
+	       c3.y - c0.y - coeffs[2].y - coeffs[1].y};
+}
+
+
+/*
+ * Try to approximate a cubic, given by its coefficients, with a spline
+ * of n ≥ 2 quadratics whose joins are the midpoints of adjacent control
+ * points, as in TrueType outlines.  On success fills control[0..n-1]
+ * and returns true.
+ */
+static bool
+cubic_approx_spline (const Point coeffs[4], Point c0,
+		     unsigned n, const tolerance_t &tolerance, Point *control)
+{
+  Point next[4];
+  split_cubic_segment (coeffs, 0, n, next);
+  Point next_q1 = cubic_approx_control (0, next[0], next[1], next[2], next[3]);
+  Point q2 = c0;
+  Point d1 = {0, 0};
+
+  for (unsigned i = 1; i <= n; i++)
+  {
+    /* Segment i − 1 and its quadratic (q0, q1, q2) */
+    Point seg[4] = {next[0], next[1], next[2], next[3]};
+    Point q0 = q2;
+    Point q1 = next_q1;
+    control[i - 1] = q1;
+
+    if (i < n)
+    {
+      split_cubic_segment (coeffs, i, n, next);
+      next_q1 = cubic_approx_control (i / (double) (n - 1),
+				      next[0], next[1], next[2], next[3]);
+      q2 = point_lerp (q1, next_q1, 0.5);
+    }
+    else
+      q2 = seg[3];
+
+    /* The error curve runs from the previous join error to this one. */
+    Point d0 = d1;
+    d1 = {q2.x - seg[3].x, q2.y - seg[3].y};
+    Point err1 = {q0.x + (q1.x - q0.x) * (2.0 / 3.0) - seg[1].x,
+		  q0.y + (q1.y - q0.y) * (2.0 / 3.0) - seg[1].y};
+    Point err2 = {q2.x + (q1.x - q2.x) * (2.0 / 3.0) - seg[2].x,
+		  q2.y + (q1.y - q2.y) * (2.0 / 3.0) - seg[2].y};
+    if (distance_exceeds (d1.x, d1.y, tolerance) ||
+	!cubic_farthest_fit_inside (d0, err1, err2, d1, tolerance))
+      return false;
+  }
+
+  return true;
 }
 
 
@@ -151,34 +390,64 @@ split_cubic_half (Point c0, Point c1, Point c2, Point c3,
 
 
 /*
- * Recursively convert a cubic into quadratic segments, emitting each
- * via glyphy_conic_to.
+ * Convert a cubic into quadratic segments, emitting each via
+ * glyphy_conic_to.  Like fontTools' curve_to_quadratic, try splines of
+ * one to CU2QU_MAX_N quadratics; only if none fits, subdivide.  Halves
+ * still to convert wait on a stack, second half below the first.
  */
 static void
 cubic_to_quadratics (glyphy_t *acc,
 		     Point c0, Point c1, Point c2, Point c3,
-		     double tolerance, unsigned depth)
+		     const tolerance_t &tolerance)
 {
-  /* Try a single quadratic approximation first. */
-  Point q1;
-  if (cubic_approx_quadratic (c0, c1, c2, c3, tolerance, &q1))
-  {
-    glyphy_conic_to (acc, &q1, &c3);
-    return;
-  }
+  struct pending_t { Point c[4]; unsigned depth; };
+  pending_t stack[CU2QU_MAX_DEPTH + 2];
+  unsigned stack_len = 0;
 
-  /* At max depth, give up and emit a straight line. */
-  if (depth >= CU2QU_MAX_DEPTH)
+  stack[stack_len++] = pending_t {{c0, c1, c2, c3}, 0};
+  while (stack_len)
   {
-    glyphy_line_to (acc, &c3);
-    return;
+    const pending_t p = stack[--stack_len];
+    const Point *c = p.c;
+
+    /* Try a single quadratic approximation first. */
+    Point q1;
+    if (cubic_approx_quadratic (c[0], c[1], c[2], c[3], tolerance, &q1))
+    {
+      glyphy_conic_to (acc, &q1, &c[3]);
+      continue;
+    }
+
+    Point coeffs[4], control[CU2QU_MAX_N];
+    cubic_coefficients (c[0], c[1], c[2], c[3], coeffs);
+    unsigned n;
+    for (n = 2; n <= CU2QU_MAX_N; n++)
+      if (cubic_approx_spline (coeffs, c[0], n, tolerance, control))
+	break;
+    if (n <= CU2QU_MAX_N)
+    {
+      for (unsigned i = 0; i + 1 < n; i++)
+      {
+	Point join = point_lerp (control[i], control[i + 1], 0.5);
+	glyphy_conic_to (acc, &control[i], &join);
+      }
+      glyphy_conic_to (acc, &control[n - 1], &c[3]);
+      continue;
+    }
+
+    /* At max depth, give up and emit a straight line. */
+    if (p.depth >= CU2QU_MAX_DEPTH)
+    {
+      glyphy_line_to (acc, &c[3]);
+      continue;
+    }
+
+    /* Subdivide. */
+    Point pts[7];
+    split_cubic_half (c[0], c[1], c[2], c[3], pts);
+    stack[stack_len++] = pending_t {{pts[3], pts[4], pts[5], pts[6]}, p.depth + 1};
+    stack[stack_len++] = pending_t {{pts[0], pts[1], pts[2], pts[3]}, p.depth + 1};
   }
-
-  /* Subdivide and recurse. */
-  Point pts[7];
-  split_cubic_half (c0, c1, c2, c3, pts);
-  cubic_to_quadratics (acc, pts[0], pts[1], pts[2], pts[3], tolerance, depth + 1);
-  cubic_to_quadratics (acc, pts[3], pts[4], pts[5], pts[6], tolerance, depth + 1);
 }
 
 
@@ -201,5 +470,12 @@ glyphy_cubic_to (glyphy_t *acc,
       p2->x == p3->x && p2->y == p3->y)
     return;
 
-  cubic_to_quadratics (acc, c0, *p1, *p2, *p3, GLYPHY_CU2QU_TOLERANCE, 0);
+  if (acc->curves.cubic)
+  {
+    glyphy_emit_cubic (acc, p1, p2, p3);
+    return;
+  }
+
+  cubic_to_quadratics (acc, c0, *p1, *p2, *p3,
+		       make_tolerance (acc->cu2qu_tolerance));
 }
@@ -11,6 +11,7 @@
 #include "glyphy.hh"
 
 #include <cstdint>
+#include <cstring>
 #include <cmath>
 #include <limits>
 #include <vector>
@@ -22,10 +23,20 @@
  *
  * Blob layout (single RGBA16I texture region):
  *
+ *   [Blob header (2 texels)]
  *   [H-band headers (num_hbands texels)]
  *   [V-band headers (num_vbands texels)]
+ *   [Band edge tables (GLYPHY_BLOB_FLAG_BALANCED_BANDS only)]
+ *   [Cell grid (GLYPHY_BLOB_FLAG_CELL_GRID only)]
  *   [Curve index lists (variable)]
- *   [Curve data (2 texels per curve)]
+ *   [Curve data (about 1 texel per quadratic, 2 per cubic)]
+ *
+ * Blob header:
+ *   Texel 0: R=min_x, G=min_y, B=max_x, A=max_y  (quantized extents)
+ *   Texel 1: R=num_hbands, G=num_vbands, B=format flags,
+ *            A=offset to the cell grid (from blob start), or 0
+ *   With GLYPHY_FLAG_SINGLE_AXIS one of num_hbands and num_vbands is
+ *   0, and that axis has no band headers, edges or lists.
  *
  * Band header texel:
  *   R = curve count
@@ -33,66 +44,280 @@
  *   B = offset to ascending curve index list (from blob start)
  *   A = split value for symmetric optimization
  *
- * Curve index texel:
- *   R = offset to curve data (from blob start)
- *   G = reserved
- *   B = reserved
- *   A = reserved
+ * Band edge tables, h-bands then v-bands:
+ *   The num_bands - 1 interior band edges of each axis, ascending,
+ *   four per texel; lanes past the end are INT16_MAX.  A sample falls
+ *   in the band numbered by the count of edges at or below it.  Without
+ *   this flag the bands split the extents evenly.
+ *
+ * Cell grid:
+ *   GLYPHY_CELL_GRID_SIZE squared cells over the quantized extents,
+ *   row by row from the bottom, two bits each: 0 for cells that curves
+ *   pass through, 1 for empty and 2 for solid ones.  Eight cells per
+ *   lane from the low bits up, 32 per texel.  Samples in empty or solid
+ *   cells, half a pixel or more from the cell's sides, skip the curve
+ *   loops.  Only stored if some cell is empty or solid.
+ *
+ * Curve index texel (four curves per texel, in list order):
+ *   R, G, B, A = offsets to curve data (from blob start)
+ *   Lanes past the end of a list are 0.
+ *
+ * With GLYPHY_BLOB_FLAG_BOUNDED_INDICES, one curve per texel instead:
+ *   R = offset to curve data
+ *   G = sort key along the ray (max for descending, min for ascending lists)
+ *   B = min across the ray (y for h-bands, x for v-bands)
+ *   A = max across the ray
+ *   All quantized like the curve data, so the shader can run the break
+ *   test and reject curves off the pixel row without fetching them.
  *
  * Curve data (2 consecutive texels):
  *   Texel 0: R=p1.x, G=p1.y, B=p2.x, A=p2.y  (int16, em-space * UNITS_PER_EM_UNIT)
  *   Texel 1: R=p3.x, G=p3.y, B=0, A=0
+ *   Consecutive curves of a contour share texels; see glyphy_encode().
+ *   Lines have p2 == p1, so the shader can solve them linearly.
+ *
+ * With GLYPHY_BLOB_FLAG_SUB_BANDS there are no edge tables, and band
+ * headers and index lists change:
+ *   Band header: R = number of sub-cells, G, B = offset to its first
+ *                sub-cell header, A = 0
+ *   Sub-cell header (a band's sub-cells split the extents evenly along
+ *   the ray):
+ *                R = curve count, G, B = offset to the curve index list,
+ *                A = coverage the curves left out of the list add
+ *   Curve index texel: R, G and B, A = offsets to curve data, two per
+ *                texel; lanes past the end of a list are 0.
+ *   Offsets are 32-bit, low half first.  Sub-cell headers of all bands
+ *   of an axis come first, then their lists; h-bands first.  Lists are
+ *   sorted for rightward and upward rays only.
+ *
+ * With GLYPHY_BLOB_FLAG_CUBICS every curve is a cubic, monotonic in x
+ * and y, in 2 texels of its own:
+ *   Texel 0: R=p1.x, G=p1.y, B=p2.x, A=p2.y
+ *   Texel 1: R=p3.x, G=p3.y, B=p4.x, A=p4.y
+ *   Lines have p2 == p1 and p3 == p4.
  *
  * All offsets are 1D from blob start. The shader converts to 2D atlas
  * coordinates using the atlas width, similar to Slug's CalcBandLoc.
  */
 
 
-static int16_t
-quantize (double v)
+/* Blob format flags, in blob header texel 1, lane B. */
+enum {
+  GLYPHY_BLOB_FLAG_BOUNDED_INDICES = 0x0001,
+  GLYPHY_BLOB_FLAG_BALANCED_BANDS  = 0x0002,
+  GLYPHY_BLOB_FLAG_CUBICS          = 0x0004,
+  GLYPHY_BLOB_FLAG_CELL_GRID       = 0x0008,
+  GLYPHY_BLOB_FLAG_SUB_BANDS       = 0x0010,
+};
+
+
+/* Number of texels taken by a list of count curve indices. */
+static unsigned int
+index_list_len (unsigned int count,
+                bool         bounded)
+{
+  return bounded ? count : (count + 3) / 4;
+}
+
+/* Pack a curve index list, four per texel, starting at texel offset.
+ * Returns the offset past the list. */
+static unsigned int
+pack_index_list (glyphy_texel_t     *blob,
+                 unsigned int        offset,
+                 const unsigned int *curves,
+                 unsigned int        count,
+                 const unsigned int *curve_texel_offset)
+{
+  for (unsigned int ci = 0; ci < count; ci += 4) {
+    int16_t lanes[4] = {0, 0, 0, 0};
+    for (unsigned int k = 0; k < 4 && ci + k < count; k++)
+      lanes[k] = (int16_t) curve_texel_offset[curves[ci + k]];
+    blob[offset].r = lanes[0];
+    blob[offset].g = lanes[1];
+    blob[offset].b = lanes[2];
+    blob[offset].a = lanes[3];
+    offset++;
+  }
+  return offset;
+}
+
+/* Pack a curve index list with per-curve bounds, one per texel.
+ * vertical selects v-band (y-ray) keys; ascending selects min keys. */
+static unsigned int
+pack_bounded_index_list (glyphy_texel_t            *blob,
+                         unsigned int               offset,
+                         const unsigned int        *curves,
+                         unsigned int               count,
+                         const unsigned int        *curve_texel_offset,
+                         const glyphy_curve_info_t *curve_infos,
+                         bool                       vertical,
+                         bool                       ascending)
+{
+  for (unsigned int ci = 0; ci < count; ci++) {
+    const glyphy_curve_info_t &info = curve_infos[curves[ci]];
+    blob[offset].r = (int16_t) curve_texel_offset[curves[ci]];
+    if (!vertical) {
+      blob[offset].g = ascending ? info.qmin_x : info.qmax_x;
+      blob[offset].b = info.qmin_y;
+      blob[offset].a = info.qmax_y;
+    } else {
+      blob[offset].g = ascending ? info.qmin_y : info.qmax_y;
+      blob[offset].b = info.qmin_x;
+      blob[offset].a = info.qmax_x;
+    }
+    offset++;
+  }
+  return offset;
+}
+
+/* Pack the GLYPHY_FLAG_CELL_GRID cell states, two bits each, eight per
+ * lane, starting at texel offset. */
+static void
+pack_cell_grid (glyphy_texel_t             *blob,
+                unsigned int                offset,
+                const std::vector<uint8_t> &cells)
+{
+  for (unsigned int c = 0; c < cells.size (); c += 32) {
+    uint16_t lanes[4] = {0, 0, 0, 0};
+    for (unsigned int k = 0; k < 32; k++)
+      lanes[k >> 3] |= cells[c + k] << (2 * (k & 7));
+    blob[offset].r = (int16_t) lanes[0];
+    blob[offset].g = (int16_t) lanes[1];
+    blob[offset].b = (int16_t) lanes[2];
+    blob[offset].a = (int16_t) lanes[3];
+    offset++;
+  }
+}
+
+/* Store 32-bit offset v in two lanes, low half first. */
+static inline void
+set_offset32 (short &lo, short &hi, unsigned int v)
 {
-  return (int16_t) round (v * GLYPHY_UNITS_PER_EM_UNIT);
+  lo = (int16_t) (uint16_t) (v & 0xFFFF);
+  hi = (int16_t) (uint16_t) (v >> 16);
 }
 
+/* Pack one axis of sub-bands: band headers at *hdr onwards, then
+ * sub-cell headers and index lists starting at texel offset.  Returns
+ * the offset past them. */
+static unsigned int
+pack_sub_bands (glyphy_texel_t                   *blob,
+                unsigned int                     *hdr,
+                unsigned int                      offset,
+                const glyphy_sub_bands_scratch_t *sub,
+                const unsigned int               *curve_texel_offset)
+{
+  unsigned int cell = 0;
+  unsigned int index_offset = offset + sub->num_cells;
+  for (unsigned int b = 0; b < sub->num_bands; b++) {
+    glyphy_texel_t &band = blob[(*hdr)++];
+    band.r = (int16_t) sub->band_cells[b];
+    set_offset32 (band.g, band.b, offset + cell);
+    band.a = 0;
+
+    for (unsigned int end = cell + sub->band_cells[b]; cell < end; cell++) {
+      const unsigned int *curves = &sub->curves[sub->cell_offsets[cell]];
+      unsigned int count = sub->cell_counts[cell];
+      glyphy_texel_t &header = blob[offset + cell];
+      header.r = (int16_t) count;
+      set_offset32 (header.g, header.b, index_offset);
+      header.a = (int16_t) sub->cell_windings[cell];
+
+      for (unsigned int ci = 0; ci < count; ci += 2) {
+        glyphy_texel_t &entry = blob[index_offset++];
+        set_offset32 (entry.r, entry.g, curve_texel_offset[curves[ci]]);
+        if (ci + 1 < count)
+          set_offset32 (entry.b, entry.a, curve_texel_offset[curves[ci + 1]]);
+        else
+          entry.b = entry.a = 0;
+      }
+    }
+  }
+  return index_offset;
+}
+
+/* Whether quantized point c lies on the segment from a to b. */
 static bool
-quantize_fits_i16 (double v)
+on_segment (const int16_t a[2],
+            const int16_t c[2],
+            const int16_t b[2])
 {
-  double q = round (v * GLYPHY_UNITS_PER_EM_UNIT);
-  return q >= std::numeric_limits<int16_t>::min () &&
-         q <= std::numeric_limits<int16_t>::max ();
+  if (c[0] < std::min (a[0], b[0]) || c[0] > std::max (a[0], b[0]) ||
+      c[1] < std::min (a[1], b[1]) || c[1] > std::max (a[1], b[1]))
+    return false;
+  return (int64_t) (c[0] - a[0]) * (b[1] - a[1]) ==
+         (int64_t) (c[1] - a[1]) * (b[0] - a[0]);
 }
 
-typedef struct
+/* A quadratic whose control point is on its chord is the chord.  Move
+ * the control point onto p1, which is how the shader tells lines. */
+static void
+mark_line (int16_t q[6])
 {
-  double min_x;
-  double max_x;
-  double min_y;
-  double max_y;
-  bool is_horizontal;
-  bool is_vertical;
-  int hband_lo;
-  int hband_hi;
-  int vband_lo;
-  int vband_hi;
-} curve_info_t;
+  if (on_segment (q, q + 2, q + 4)) {
+    q[2] = q[0];
+    q[3] = q[1];
+  }
+}
 
-static curve_info_t
-curve_info (const glyphy_curve_t *c)
+/* Same for a cubic: its control points go onto p1 and p4. */
+static void
+mark_cubic_line (int16_t q[8])
 {
-  curve_info_t info;
+  if (on_segment (q, q + 2, q + 6) && on_segment (q, q + 4, q + 6)) {
+    q[2] = q[0];
+    q[3] = q[1];
+    q[4] = q[6];
+    q[5] = q[7];
+  }
+}
 
-  info.min_x = std::min (std::min (c->p1.x, c->p2.x), c->p3.x);
-  info.max_x = std::max (std::max (c->p1.x, c->p2.x), c->p3.x);
-  info.min_y = std::min (std::min (c->p1.y, c->p2.y), c->p3.y);
-  info.max_y = std::max (std::max (c->p1.y, c->p2.y), c->p3.y);
-  info.is_horizontal = c->p1.y == c->p2.y && c->p2.y == c->p3.y;
-  info.is_vertical = c->p1.x == c->p2.x && c->p2.x == c->p3.x;
-  info.hband_lo = 0;
-  info.hband_hi = -1;
-  info.vband_lo = 0;
-  info.vband_hi = -1;
+/* GLYPHY_BLOB_FLAG_CUBICS: pack each curve into two texels of its own,
+ * starting at texel offset, and record where. */
+static void
+pack_cubics (glyphy_texel_t        *blob,
+             unsigned int           offset,
+             const glyphy_curves_t &curves,
+             unsigned int          *curve_texel_offset)
+{
+  unsigned int num_curves = curves.size ();
+  for (unsigned int i = 0; i < num_curves; i++) {
+    int16_t q[8];
+    curves.get_quantized_cubic (i, q);
+    mark_cubic_line (q);
+    curve_texel_offset[i] = offset;
+    blob[offset].r = q[0];
+    blob[offset].g = q[1];
+    blob[offset].b = q[2];
+    blob[offset].a = q[3];
+    blob[offset + 1].r = q[4];
+    blob[offset + 1].g = q[5];
+    blob[offset + 1].b = q[6];
+    blob[offset + 1].a = q[7];
+    offset += 2;
+  }
+}
 
-  return info;
+/* Pack a balanced band edge table, four per texel.  Lanes past the
+ * end are INT16_MAX, so they never count as being below a sample. */
+static unsigned int
+pack_band_edges (glyphy_texel_t               *blob,
+                 unsigned int                  offset,
+                 const glyphy_bands_scratch_t *bands)
+{
+  unsigned int num_edges = bands->edges.size ();
+  for (unsigned int e = 0; e < num_edges; e += 4) {
+    int16_t lanes[4];
+    for (unsigned int k = 0; k < 4; k++)
+      lanes[k] = e + k < num_edges ? glyphy_quantize (bands->edges[e + k])
+                                   : std::numeric_limits<int16_t>::max ();
+    blob[offset].r = lanes[0];
+    blob[offset].g = lanes[1];
+    blob[offset].b = lanes[2];
+    blob[offset].a = lanes[3];
+    offset++;
+  }
+  return offset;
 }
 
 /*
@@ -103,6 +328,10 @@ glyphy_t *
 glyphy_create (void)
 {
   glyphy_t *g = new glyphy_t;
+  g->flags = GLYPHY_FLAG_DEFAULT;
+  g->max_blob_len = 0;
+  g->cu2qu_tolerance = GLYPHY_CU2QU_TOLERANCE;
+  g->tiles.g = nullptr;
   glyphy_reset (g);
   return g;
 }
@@ -110,6 +339,8 @@ glyphy_create (void)
 void
 glyphy_destroy (glyphy_t *g)
 {
+  if (g->tiles.g)
+    glyphy_destroy (g->tiles.g);
   delete g;
 }
 
@@ -120,14 +351,65 @@ glyphy_reset (glyphy_t *g)
   g->need_moveto = true;
   g->num_curves = 0;
   g->success = true;
+  g->curves.fixed = g->flags & GLYPHY_FLAG_FIXED_POINT;
+  g->curves.cubic = g->flags & GLYPHY_FLAG_NATIVE_CUBICS;
   g->curves.clear ();
+  g->scratch.layout_valid = false;
+}
+
+void
+glyphy_set_flags (glyphy_t     *g,
+                  unsigned int  flags)
+{
+  bool format_changed = (g->flags ^ flags) & (GLYPHY_FLAG_FIXED_POINT |
+                                              GLYPHY_FLAG_NATIVE_CUBICS);
+  g->flags = flags;
+  g->scratch.layout_valid = false;
+  /* Accumulated curves are stored in one representation only. */
+  if (format_changed)
+    glyphy_reset (g);
+}
+
+unsigned int
+glyphy_get_flags (glyphy_t *g)
+{
+  return g->flags;
+}
+
+void
+glyphy_set_max_blob_len (glyphy_t     *g,
+                         unsigned int  max_len)
+{
+  g->max_blob_len = max_len;
+  g->scratch.layout_valid = false;
+}
+
+unsigned int
+glyphy_get_max_blob_len (glyphy_t *g)
+{
+  return g->max_blob_len;
+}
+
+void
+glyphy_set_cu2qu_tolerance (glyphy_t *g,
+                            double    tolerance)
+{
+  g->cu2qu_tolerance = tolerance > 0 ? tolerance : GLYPHY_CU2QU_TOLERANCE;
+}
+
+double
+glyphy_get_cu2qu_tolerance (glyphy_t *g)
+{
+  return g->cu2qu_tolerance;
 }
 
 static void
 emit (glyphy_t *g, const glyphy_curve_t *curve)
 {
-  g->curves.push_back (*curve);
-  g->num_curves++;
+  if (!g->curves.push_back (*curve))
+    g->success = false;
+  g->num_curves = g->curves.size ();
+  g->scratch.layout_valid = false;
   g->current_point = curve->p3;
 }
 
@@ -139,6 +421,22 @@ emit_conic (glyphy_t *g,
   if (g->current_point.x == p3->x && g->current_point.y == p3->y)
     return;
 
+  if (g->curves.cubic) {
+    /* Degree-elevate; lines keep their control points on the ends,
+     * which marks them as lines in the blob. */
+    glyphy_point_t p1 = g->current_point;
+    glyphy_point_t c1, c2;
+    if (p2->x == p1.x && p2->y == p1.y) {
+      c1 = p1;
+      c2 = *p3;
+    } else {
+      c1 = {p1.x + (p2->x - p1.x) * (2. / 3), p1.y + (p2->y - p1.y) * (2. / 3)};
+      c2 = {p3->x + (p2->x - p3->x) * (2. / 3), p3->y + (p2->y - p3->y) * (2. / 3)};
+    }
+    glyphy_emit_cubic (g, &c1, &c2, p3);
+    return;
+  }
+
   if (g->need_moveto) {
     g->start_point = g->current_point;
     g->need_moveto = false;
@@ -148,6 +446,64 @@ emit_conic (glyphy_t *g,
   emit (g, &curve);
 }
 
+void
+glyphy_emit_cubic (glyphy_t             *g,
+                   const glyphy_point_t *p1,
+                   const glyphy_point_t *p2,
+                   const glyphy_point_t *p3)
+{
+  if (g->need_moveto) {
+    g->start_point = g->current_point;
+    g->need_moveto = false;
+  }
+
+  glyphy_point_t c[4] = {g->current_point, *p1, *p2, *p3};
+
+  /* Where the cubic turns in x (axis 1) or y (axis 2), in order. */
+  struct turn_t { double t; unsigned int axes; } turns[4];
+  unsigned int num_turns = 0;
+  double t[2];
+  unsigned int n = glyphy_bezier_turns (c, 4, false, t);
+  for (unsigned int i = 0; i < n; i++)
+    turns[num_turns++] = {t[i], 1};
+  n = glyphy_bezier_turns (c, 4, true, t);
+  for (unsigned int i = 0; i < n; i++)
+    turns[num_turns++] = {t[i], 2};
+  for (unsigned int i = 1; i < num_turns; i++)
+    for (unsigned int j = i; j && turns[j].t < turns[j - 1].t; j--)
+      std::swap (turns[j], turns[j - 1]);
+
+  /* Split there, so that the shader finds at most one crossing per
+   * piece.  The control points next to a turn lie level with it; make
+   * them so exactly, lest rounding make the piece turn back. */
+  double done = 0;
+  for (unsigned int i = 0; i < num_turns; i++) {
+    unsigned int axes = turns[i].axes;
+    while (i + 1 < num_turns && turns[i + 1].t - turns[i].t < 1e-9)
+      axes |= turns[++i].axes;
+    double local_t = (turns[i].t - done) / (1 - done);
+    if (local_t < 1e-9 || local_t > 1 - 1e-9)
+      continue;
+
+    glyphy_point_t left[4], right[4];
+    glyphy_bezier_split (c, 4, local_t, left, right);
+    if (axes & 1)
+      left[2].x = right[1].x = left[3].x;
+    if (axes & 2)
+      left[2].y = right[1].y = left[3].y;
+    if (!g->curves.push_back_cubic (left))
+      g->success = false;
+    memcpy (c, right, sizeof (c));
+    done = turns[i].t;
+  }
+  if (!g->curves.push_back_cubic (c))
+    g->success = false;
+
+  g->num_curves = g->curves.size ();
+  g->scratch.layout_valid = false;
+  g->current_point = *p3;
+}
+
 void
 glyphy_move_to (glyphy_t *g, const glyphy_point_t *p0)
 {
@@ -181,6 +537,151 @@ glyphy_close_path (glyphy_t *g)
     glyphy_line_to (g, &g->start_point);
 }
 
+
+/*
+ * Bulk drawing
+ */
+
+static inline glyphy_point_t
+midpoint (const glyphy_point_t &a, const glyphy_point_t &b)
+{
+  return {(a.x + b.x) * .5, (a.y + b.y) * .5};
+}
+
+/* Draws points (first, last] of one contour, as FT_Outline_Decompose()
+ * does.  Returns false if the tags are malformed. */
+static bool
+append_contour (glyphy_t             *g,
+                const glyphy_point_t *points,
+                const unsigned char  *tags,
+                int                   first,
+                int                   last)
+{
+  glyphy_point_t start = points[first];
+  int i = first;
+
+  switch (tags[first] & 3) {
+  case GLYPHY_POINT_TAG_ON:
+    break;
+  case GLYPHY_POINT_TAG_CONIC:
+    /* Start at the last point if it is on the curve, else midway
+     * between the first and last control points. */
+    if ((tags[last] & 3) == GLYPHY_POINT_TAG_ON) {
+      start = points[last];
+      last--;
+    } else
+      start = midpoint (points[first], points[last]);
+    i--;
+    break;
+  default:
+    return false;
+  }
+
+  glyphy_close_path (g);
+  glyphy_move_to (g, &start);
+
+  while (i < last) {
+    i++;
+    switch (tags[i] & 3) {
+    case GLYPHY_POINT_TAG_ON:
+      {
+        glyphy_point_t p0 = g->current_point;
+        emit_conic (g, &p0, &points[i]);
+      }
+      break;
+
+    case GLYPHY_POINT_TAG_CONIC:
+      {
+        glyphy_point_t control = points[i];
+        for (;;) {
+          if (i == last) {
+            emit_conic (g, &control, &start);
+            return true;
+          }
+          i++;
+          unsigned int tag = tags[i] & 3;
+          if (tag == GLYPHY_POINT_TAG_ON) {
+            emit_conic (g, &control, &points[i]);
+            break;
+          }
+          if (tag != GLYPHY_POINT_TAG_CONIC)
+            return false;
+          glyphy_point_t middle = midpoint (control, points[i]);
+          emit_conic (g, &control, &middle);
+          control = points[i];
+        }
+      }
+      break;
+
+    default:
+      if (i + 1 > last || (tags[i + 1] & 3) != GLYPHY_POINT_TAG_CUBIC)
+        return false;
+      i += 2;
+      glyphy_cubic_to (g, &points[i - 2], &points[i - 1],
+                       i <= last ? &points[i] : &start);
+      if (i > last)
+        return true;
+      break;
+    }
+  }
+
+  glyphy_close_path (g);
+  return true;
+}
+
+void
+glyphy_append_outline (glyphy_t             *g,
+                       const glyphy_point_t *points,
+                       const unsigned char  *tags,
+                       unsigned int          num_points,
+                       const unsigned int   *contour_ends,
+                       unsigned int          num_contours)
+{
+  /* Every point starts at most one quadratic, and each contour may add
+   * a closing line; cubics may need more. */
+  g->curves.reserve (g->curves.size () + num_points + num_contours);
+
+  unsigned int first = 0;
+  for (unsigned int c = 0; c < num_contours; c++) {
+    unsigned int last = contour_ends[c];
+    if (last < first || last >= num_points ||
+        !append_contour (g, points, tags, first, last)) {
+      g->success = false;
+      return;
+    }
+    first = last + 1;
+  }
+  glyphy_close_path (g);
+  g->need_moveto = true;
+}
+
+void
+glyphy_append_quadratics (glyphy_t             *g,
+                          const glyphy_point_t *points,
+                          unsigned int          num_quadratics)
+{
+  glyphy_close_path (g);
+  if (!num_quadratics)
+    return;
+
+  if (g->curves.cubic) {
+    for (unsigned int i = 0; i < num_quadratics; i++) {
+      g->current_point = points[3 * i];
+      g->need_moveto = true;
+      emit_conic (g, &points[3 * i + 1], &points[3 * i + 2]);
+    }
+    g->need_moveto = true;
+    return;
+  }
+
+  if (!g->curves.append_quadratics (points, num_quadratics))
+    g->success = false;
+  g->num_curves = g->curves.size ();
+  g->scratch.layout_valid = false;
+  g->current_point = points[3 * num_quadratics - 1];
+  g->need_moveto = true;
+}
+
 void
 glyphy_get_current_point (glyphy_t *g, glyphy_point_t *point)
 {
@@ -201,373 +702,997 @@ glyphy_successful (glyphy_t *g)
 
 
 /*
- * Encode accumulated curves into blob
+ * Lay out the blob: extents, bands and sorted curve lists.
+ *
+ * The result lives in g->scratch and stays valid until the curves
+ * change, so that sizing a blob and then encoding it does the work once.
  */
 
-glyphy_bool_t
-glyphy_encode (glyphy_t         *g,
-               glyphy_texel_t   *blob,
-               unsigned int      blob_size,
-               unsigned int     *output_len,
-               glyphy_extents_t *extents)
+/* The curves to lay out and encode: the accumulated curves, or the
+ * copy prepare_curves() reworked. */
+static inline const glyphy_curves_t &
+encode_curves (const glyphy_t *g)
 {
-  const glyphy_curve_t *curves = g->curves.data ();
-  unsigned int num_curves = g->curves.size ();
+  return g->scratch.reworked ? g->scratch.prepared : g->curves;
+}
 
-  if (num_curves == 0) {
-    glyphy_extents_clear (extents);
-    *output_len = 0;
-    return true;
+/* Fixed band count per axis (capped at 16 per Slug paper) */
+#define GLYPHY_DEFAULT_MAX_BANDS 16
+/* Expected curve tests per fragment a band must save to be worth its
+ * header and the indices it duplicates */
+#define GLYPHY_ADAPTIVE_BAND_COST (1. / 32)
+
+/* Curve bounds along the rays of one band axis.  H-bands are crossed
+ * by horizontal rays, so their ray axis is x; v-bands the other way. */
+static inline double
+ray_min (const glyphy_curve_info_t &info, bool vertical)
+{
+  return vertical ? info.min_y : info.min_x;
+}
+
+static inline double
+ray_max (const glyphy_curve_info_t &info, bool vertical)
+{
+  return vertical ? info.max_y : info.max_x;
+}
+
+static inline int16_t
+ray_qmin (const glyphy_curve_info_t &info, bool vertical)
+{
+  return vertical ? info.qmin_y : info.qmin_x;
+}
+
+static inline int16_t
+ray_qmax (const glyphy_curve_info_t &info, bool vertical)
+{
+  return vertical ? info.qmax_y : info.qmax_x;
+}
+
+static inline double
+band_min (const glyphy_curve_info_t &info, bool vertical)
+{
+  return vertical ? info.min_x : info.min_y;
+}
+
+static inline double
+band_max (const glyphy_curve_info_t &info, bool vertical)
+{
+  return vertical ? info.max_x : info.max_y;
+}
+
+static inline int16_t
+band_qmin (const glyphy_curve_info_t &info, bool vertical)
+{
+  return vertical ? info.qmin_x : info.qmin_y;
+}
+
+static inline int16_t
+band_qmax (const glyphy_curve_info_t &info, bool vertical)
+{
+  return vertical ? info.qmax_x : info.qmax_y;
+}
+
+/* Sort a band's curve list by quantized max along the ray, descending,
+ * or by quantized min, ascending.  These are the values the shader
+ * tests against, and ties keep curve order, so the result does not
+ * depend on the sort algorithm. */
+static void
+sort_band_list (glyphy_bands_scratch_t                 *bands,
+                unsigned int                           *list,
+                unsigned int                            count,
+                const std::vector<glyphy_curve_info_t> &curve_infos,
+                bool                                    vertical,
+                bool                                    descending)
+{
+  std::vector<glyphy_sort_item_t> &items = bands->sort_items;
+  std::vector<glyphy_sort_item_t> &tmp = bands->sort_tmp;
+  if (items.size () < count) {
+    items.resize (count);
+    tmp.resize (count);
   }
 
-  std::vector<curve_info_t> curve_infos;
-  curve_infos.resize (num_curves);
-  glyphy_extents_clear (extents);
-  for (unsigned int i = 0; i < num_curves; i++) {
-    curve_infos[i] = curve_info (&curves[i]);
+  for (unsigned int i = 0; i < count; i++) {
+    const glyphy_curve_info_t &info = curve_infos[list[i]];
+    int16_t v = descending ? ray_qmax (info, vertical) : ray_qmin (info, vertical);
+    items[i].key = glyphy_sort_key (v, descending);
+    items[i].value = list[i];
+  }
 
-    if (i == 0) {
-      extents->min_x = curve_infos[i].min_x;
-      extents->max_x = curve_infos[i].max_x;
-      extents->min_y = curve_infos[i].min_y;
-      extents->max_y = curve_infos[i].max_y;
-    } else {
-      extents->min_x = std::min (extents->min_x, curve_infos[i].min_x);
-      extents->max_x = std::max (extents->max_x, curve_infos[i].max_x);
-      extents->min_y = std::min (extents->min_y, curve_infos[i].min_y);
-      extents->max_y = std::max (extents->max_y, curve_infos[i].max_y);
+  glyphy_radix_sort (items.data (), tmp.data (), count);
+
+  for (unsigned int i = 0; i < count; i++)
+    list[i] = items[i].value;
+}
+
+/* GLYPHY_FLAG_BALANCED_BANDS: greedily place edges so that no band
+ * overlaps more than max_count curves.  mins and maxs are the sorted
+ * quantized curve bounds across the bands.  Band b covers
+ * [edges[b-1], edges[b]) and overlaps the curves with min < edges[b] and
+ * max >= edges[b-1], of which there are #(min < edges[b]) - #(max <
+ * edges[b-1]).  Returns false if num_bands bands are not enough. */
+static bool
+place_band_edges (const std::vector<double> &mins,
+                  const std::vector<double> &maxs,
+                  double                     end,
+                  unsigned int               num_bands,
+                  unsigned int               max_count,
+                  std::vector<double>       &edges)
+{
+  unsigned int num_curves = mins.size ();
+  unsigned int done = 0; /* Curves ending below the current band */
+  double start = -std::numeric_limits<double>::infinity ();
+
+  edges.resize (num_bands - 1);
+  for (unsigned int b = 0; b + 1 < num_bands; b++) {
+    unsigned int m = max_count + done;
+    if (m >= num_curves)
+      edges[b] = end; /* The rest fits; leave the remaining bands empty. */
+    else {
+      edges[b] = mins[m];
+      if (edges[b] <= start)
+        return false;
+    }
+    start = edges[b];
+    done = std::lower_bound (maxs.begin (), maxs.end (), start) - maxs.begin ();
+  }
+
+  return num_curves - done <= max_count;
+}
+
+/* Pick band edges that minimize the largest band's curve count. */
+static void
+balance_band_edges (glyphy_bands_scratch_t                 *bands,
+                    const std::vector<glyphy_curve_info_t> &curve_infos,
+                    double                                  end,
+                    bool                                    vertical,
+                    unsigned int                            num_bands)
+{
+  std::vector<double> &mins = bands->sorted_mins;
+  std::vector<double> &maxs = bands->sorted_maxs;
+  mins.clear ();
+  maxs.clear ();
+  for (const glyphy_curve_info_t &info : curve_infos) {
+    if (vertical ? info.is_vertical : info.is_horizontal)
+      continue;
+    mins.push_back (glyphy_dequantize (band_qmin (info, vertical)));
+    maxs.push_back (glyphy_dequantize (band_qmax (info, vertical)));
+  }
+  std::sort (mins.begin (), mins.end ());
+  std::sort (maxs.begin (), maxs.end ());
+
+  /* A single band holding every curve always works. */
+  unsigned int lo = 1, hi = std::max ((unsigned int) mins.size (), 1u);
+  while (lo < hi) {
+    unsigned int mid = lo + (hi - lo) / 2;
+    if (place_band_edges (mins, maxs, end, num_bands, mid, bands->edges))
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+  place_band_edges (mins, maxs, end, num_bands, lo, bands->edges);
+}
+
+/* Split the extents across one axis into num_bands bands, equal or
+ * balanced, assign curves to them, sort each band's lists and pick its
+ * split value.  With keep, the edges and splits of the last call for
+ * these bands stay as they are. */
+static void
+build_bands (glyphy_bands_scratch_t           *bands,
+             std::vector<glyphy_curve_info_t> &curve_infos,
+             const glyphy_extents_t           *extents,
+             bool                              vertical,
+             unsigned int                      num_bands,
+             unsigned int                      flags,
+             bool                              keep = false)
+{
+  unsigned int num_curves = curve_infos.size ();
+  bool bounded = flags & GLYPHY_FLAG_BOUNDED_INDICES;
+  bool balanced = flags & GLYPHY_FLAG_BALANCED_BANDS;
+  bool fixed = flags & GLYPHY_FLAG_FIXED_POINT;
+
+  double bands_start = vertical ? extents->min_x : extents->min_y;
+  double bands_end = vertical ? extents->max_x : extents->max_y;
+  double band_extent = bands_end - bands_start;
+  double ray_center = vertical ? (extents->min_y + extents->max_y) * 0.5
+                               : (extents->min_x + extents->max_x) * 0.5;
+
+  if (band_extent <= 0) num_bands = 1;
+  double band_size = band_extent / num_bands;
+
+  /* Interior band edges; with balanced bands they are quantized and
+   * stored in the blob, and decide band membership exactly. */
+  std::vector<double> &edges = bands->edges;
+  if (!keep) {
+    if (balanced && num_bands > 1)
+      balance_band_edges (bands, curve_infos, glyphy_dequantize (glyphy_quantize (bands_end)),
+                          vertical, num_bands);
+    else {
+      edges.resize (num_bands - 1);
+      for (unsigned int b = 0; b + 1 < num_bands; b++)
+        edges[b] = bands_start + band_size * (b + 1);
     }
   }
 
-  /* Choose number of bands (capped at 16 per Slug paper) */
-  unsigned int num_hbands = std::min (num_curves, 16u);
-  unsigned int num_vbands = std::min (num_curves, 16u);
-  num_hbands = std::max (num_hbands, 1u);
-  num_vbands = std::max (num_vbands, 1u);
+  std::vector<unsigned int> &curve_counts = bands->curve_counts;
+  curve_counts.assign (num_bands, 0);
 
-  double height = extents->max_y - extents->min_y;
-  double width = extents->max_x - extents->min_x;
+  for (unsigned int i = 0; i < num_curves; i++) {
+    glyphy_curve_info_t &info = curve_infos[i];
+    int &lo = vertical ? info.vband_lo : info.hband_lo;
+    int &hi = vertical ? info.vband_hi : info.hband_hi;
 
-  if (height <= 0) num_hbands = 1;
-  if (width <= 0) num_vbands = 1;
+    /* Horizontal lines never intersect horizontal rays;
+     * vertical lines never intersect vertical rays. */
+    if (vertical ? info.is_vertical : info.is_horizontal) {
+      lo = 0;
+      hi = -1;
+      continue;
+    }
 
-  double hband_size = height / num_hbands;
-  double vband_size = width / num_vbands;
+    if (balanced) {
+      /* The band of v is the number of edges at or below it.  Use the
+       * quantized bounds, as the shader sees the curve: one whose max
+       * rounds up onto an edge reaches the band above it. */
+      double bmin = glyphy_dequantize (band_qmin (info, vertical));
+      double bmax = glyphy_dequantize (band_qmax (info, vertical));
+      lo = std::upper_bound (edges.begin (), edges.end (), bmin) - edges.begin ();
+      hi = std::upper_bound (edges.begin (), edges.end (), bmax) - edges.begin ();
+    } else if (fixed && band_extent > 0) {
+      /* Exact integer band of each quantized bound. */
+      int qstart = glyphy_quantize (bands_start);
+      int64_t qextent = glyphy_quantize (bands_end) - qstart;
+      int qmin = vertical ? info.qmin_x : info.qmin_y;
+      int qmax = vertical ? info.qmax_x : info.qmax_y;
+      lo = (int) ((qmin - qstart) * (int64_t) num_bands / qextent);
+      hi = (int) ((qmax - qstart) * (int64_t) num_bands / qextent);
+      hi = std::min (hi, (int) num_bands - 1);
+    } else if (band_extent > 0) {
+      lo = (int) floor ((band_min (info, vertical) - bands_start) / band_size);
+      hi = (int) floor ((band_max (info, vertical) - bands_start) / band_size);
+      lo = std::max (lo, 0);
+      hi = std::min (hi, (int) num_bands - 1);
+    } else {
+      lo = 0;
+      hi = 0;
+    }
+    for (int b = lo; b <= hi; b++)
+      curve_counts[b]++;
+  }
 
-  std::vector<unsigned int> hband_curve_counts;
-  std::vector<unsigned int> vband_curve_counts;
-  hband_curve_counts.assign (num_hbands, 0);
-  vband_curve_counts.assign (num_vbands, 0);
+  std::vector<unsigned int> &offsets = bands->offsets;
+  offsets.resize (num_bands);
+  unsigned int total_indices = 0;
+  for (unsigned int b = 0; b < num_bands; b++) {
+    offsets[b] = total_indices;
+    total_indices += curve_counts[b];
+  }
+
+  /* Assign curves to bands */
+  std::vector<unsigned int> &curves = bands->curves;
+  std::vector<unsigned int> &curves_asc = bands->curves_asc;
+  std::vector<unsigned int> &cursors = bands->cursors;
+  curves.resize (total_indices);
+  curves_asc.resize (total_indices);
+  cursors.assign (offsets.begin (), offsets.end ());
 
   for (unsigned int i = 0; i < num_curves; i++) {
-    curve_info_t &info = curve_infos[i];
-
-    if (!info.is_horizontal) {
-      if (height > 0) {
-        info.hband_lo = (int) floor ((info.min_y - extents->min_y) / hband_size);
-        info.hband_hi = (int) floor ((info.max_y - extents->min_y) / hband_size);
-        info.hband_lo = std::max (info.hband_lo, 0);
-        info.hband_hi = std::min (info.hband_hi, (int) num_hbands - 1);
-        for (int b = info.hband_lo; b <= info.hband_hi; b++)
-          hband_curve_counts[b]++;
-      } else {
-        info.hband_lo = 0;
-        info.hband_hi = 0;
-        hband_curve_counts[0]++;
+    const glyphy_curve_info_t &info = curve_infos[i];
+    int lo = vertical ? info.vband_lo : info.hband_lo;
+    int hi = vertical ? info.vband_hi : info.hband_hi;
+    for (int b = lo; b <= hi; b++) {
+      unsigned int index = cursors[b]++;
+      curves[index] = i;
+      curves_asc[index] = i;
+    }
+  }
+
+  /* Build two sort orders per band for symmetric optimization.
+   * Descending max: for rightward/upward ray.
+   * Ascending min: for leftward/downward ray.
+   *
+   * Per-band split: find the value that minimizes
+   * max(left_count, right_count).  Curves with max >= split are
+   * processed by the rightward ray, curves with min <= split by the
+   * leftward ray.  Descending sort is by max, so try a split at each
+   * max boundary.  Splits and bounds are compared quantized, as the
+   * shader sees them, so curves that quantize alike count alike. */
+  std::vector<double> &splits = bands->splits;
+  splits.resize (num_bands);
+  unsigned int index_len = 0; /* Two index lists per band */
+
+  for (unsigned int b = 0; b < num_bands; b++) {
+    unsigned int off = offsets[b];
+    unsigned int n = curve_counts[b];
+    sort_band_list (bands, &curves[off], n, curve_infos, vertical, true);
+    sort_band_list (bands, &curves_asc[off], n, curve_infos, vertical, false);
+    index_len += 2 * index_list_len (n, bounded);
+    if (keep)
+      continue;
+
+    int16_t best_split = glyphy_quantize (ray_center);
+    unsigned int best_worst = n;
+    unsigned int left_count = n;
+    for (unsigned int ci = 0; ci < n; ci++) {
+      int16_t split = ray_qmax (curve_infos[curves[off + ci]], vertical);
+      unsigned int right_count = ci + 1; /* curves with max >= split */
+      while (left_count &&
+             ray_qmin (curve_infos[curves_asc[off + left_count - 1]], vertical) > split)
+        left_count--;
+      unsigned int worst = std::max (right_count, left_count);
+      if (worst < best_worst) {
+        best_worst = worst;
+        best_split = split;
       }
     }
+    splits[b] = glyphy_dequantize (best_split);
+  }
 
-    if (!info.is_vertical) {
-      if (width > 0) {
-        info.vband_lo = (int) floor ((info.min_x - extents->min_x) / vband_size);
-        info.vband_hi = (int) floor ((info.max_x - extents->min_x) / vband_size);
-        info.vband_lo = std::max (info.vband_lo, 0);
-        info.vband_hi = std::min (info.vband_hi, (int) num_vbands - 1);
-        for (int b = info.vband_lo; b <= info.vband_hi; b++)
-          vband_curve_counts[b]++;
-      } else {
-        info.vband_lo = 0;
-        info.vband_hi = 0;
-        vband_curve_counts[0]++;
+  bands->num_bands = num_bands;
+  bands->index_len = index_len;
+  /* Edge table, four per texel */
+  bands->edge_len = balanced ? (num_bands + 2) / 4 : 0;
+}
+
+/* Expected curve tests per fragment on one axis, for fragments spread
+ * evenly over the extents.  A fragment at ray position t right of the
+ * split tests the curves whose max reaches t; integrating over t, each
+ * curve costs its distance past the split, and likewise to the left.
+ * Bands are weighted by their share of the extents. */
+static double
+bands_cost (const glyphy_bands_scratch_t           *bands,
+            const std::vector<glyphy_curve_info_t> &curve_infos,
+            const glyphy_extents_t                 *extents,
+            bool                                    vertical)
+{
+  double ray_extent = vertical ? extents->max_y - extents->min_y
+                               : extents->max_x - extents->min_x;
+  double bands_start = vertical ? extents->min_x : extents->min_y;
+  double bands_end = vertical ? extents->max_x : extents->max_y;
+  unsigned int num_bands = bands->num_bands;
+  double cost = 0;
+
+  for (unsigned int b = 0; b < num_bands; b++) {
+    unsigned int off = bands->offsets[b];
+    unsigned int n = bands->curve_counts[b];
+    double split = bands->splits[b];
+    double band_cost;
+
+    if (ray_extent <= 0)
+      band_cost = n;
+    else {
+      double distance = 0;
+      for (unsigned int ci = 0; ci < n; ci++) {
+        const glyphy_curve_info_t &info = curve_infos[bands->curves[off + ci]];
+        distance += std::max (ray_max (info, vertical) - split, 0.) +
+                    std::max (split - ray_min (info, vertical), 0.);
       }
+      band_cost = distance / ray_extent;
+    }
+
+    if (num_bands == 1 || bands_end <= bands_start)
+      cost += band_cost;
+    else {
+      double lo = b ? bands->edges[b - 1] : bands_start;
+      double hi = b + 1 < num_bands ? bands->edges[b] : bands_end;
+      cost += band_cost * std::max (hi - lo, 0.) / (bands_end - bands_start);
     }
   }
 
-  std::vector<unsigned int> hband_offsets;
-  std::vector<unsigned int> vband_offsets;
-  hband_offsets.resize (num_hbands);
-  vband_offsets.resize (num_vbands);
-  unsigned int total_hband_indices = 0;
-  unsigned int total_vband_indices = 0;
+  return cost;
+}
+
+/* Band counts GLYPHY_FLAG_ADAPTIVE_BANDS tries, per axis */
+static const unsigned int adaptive_band_counts[] = {1, 2, 3, 4, 5, 6, 8, 10, 12, 16, 20, 24, 32};
+#define GLYPHY_ADAPTIVE_NUM_CANDIDATES \
+  (sizeof (adaptive_band_counts) / sizeof (adaptive_band_counts[0]))
 
-  for (unsigned int b = 0; b < num_hbands; b++) {
-    hband_offsets[b] = total_hband_indices;
-    total_hband_indices += hband_curve_counts[b];
+/* GLYPHY_FLAG_ADAPTIVE_BANDS: try band counts per axis and keep the
+ * pair with the lowest cost whose blob fits g->max_blob_len. */
+static void
+choose_band_counts (glyphy_t     *g,
+                    unsigned int  fixed_len,
+                    unsigned int *num_hbands,
+                    unsigned int *num_vbands)
+{
+  glyphy_scratch_t &scratch = g->scratch;
+  unsigned int num_curves = encode_curves (g).size ();
+
+  double cost[2][GLYPHY_ADAPTIVE_NUM_CANDIDATES];
+  unsigned int len[2][GLYPHY_ADAPTIVE_NUM_CANDIDATES];
+  unsigned int count[2];
+
+  for (unsigned int axis = 0; axis < 2; axis++) {
+    bool vertical = axis == 1;
+    unsigned int rising = 0;
+    count[axis] = 0;
+    for (unsigned int i = 0; i < GLYPHY_ADAPTIVE_NUM_CANDIDATES; i++) {
+      unsigned int n = adaptive_band_counts[i];
+      if (n > 1 && n > num_curves)
+        break;
+      build_bands (&scratch.trial_bands, scratch.curve_infos, &scratch.extents,
+                   vertical, n, g->flags);
+      if (scratch.trial_bands.num_bands != n)
+        break; /* Degenerate extents; only one band possible. */
+      cost[axis][i] = bands_cost (&scratch.trial_bands, scratch.curve_infos,
+                                  &scratch.extents, vertical) +
+                      n * GLYPHY_ADAPTIVE_BAND_COST;
+      len[axis][i] = n + scratch.trial_bands.edge_len + scratch.trial_bands.index_len;
+      count[axis] = i + 1;
+
+      /* Past the sweet spot more bands only cost more; stop looking. */
+      if (i && cost[axis][i] >= cost[axis][i - 1]) {
+        if (++rising == 2)
+          break;
+      } else
+        rising = 0;
+    }
   }
 
-  for (unsigned int b = 0; b < num_vbands; b++) {
-    vband_offsets[b] = total_vband_indices;
-    total_vband_indices += vband_curve_counts[b];
+  unsigned int max_len = g->max_blob_len;
+  bool found = false;
+  double best_cost = 0;
+  unsigned int best_len = 0;
+  unsigned int best_h = 0, best_v = 0;
+  unsigned int smallest_len = 0;
+  unsigned int smallest_h = 0, smallest_v = 0;
+
+  for (unsigned int h = 0; h < count[0]; h++)
+    for (unsigned int v = 0; v < count[1]; v++) {
+      unsigned int total_len = fixed_len + len[0][h] + len[1][v];
+      if ((!h && !v) || total_len < smallest_len) {
+        smallest_len = total_len;
+        smallest_h = h;
+        smallest_v = v;
+      }
+      if (max_len && total_len > max_len)
+        continue;
+      double c = cost[0][h] + cost[1][v];
+      if (!found || c < best_cost || (c == best_cost && total_len < best_len)) {
+        found = true;
+        best_cost = c;
+        best_len = total_len;
+        best_h = h;
+        best_v = v;
+      }
+    }
+
+  if (!found) {
+    best_h = smallest_h;
+    best_v = smallest_v;
   }
 
-  /* Assign curves to bands */
-  std::vector<unsigned int> hband_curves;
-  std::vector<unsigned int> hband_curves_asc;
-  std::vector<unsigned int> vband_curves;
-  std::vector<unsigned int> vband_curves_asc;
-  std::vector<unsigned int> hband_cursors;
-  std::vector<unsigned int> vband_cursors;
-  hband_curves.resize (total_hband_indices);
-  hband_curves_asc.resize (total_hband_indices);
-  vband_curves.resize (total_vband_indices);
-  vband_curves_asc.resize (total_vband_indices);
-  hband_cursors = hband_offsets;
-  vband_cursors = vband_offsets;
+  *num_hbands = adaptive_band_counts[best_h];
+  *num_vbands = adaptive_band_counts[best_v];
+}
 
-  for (unsigned int i = 0; i < num_curves; i++) {
-    const curve_info_t &info = curve_infos[i];
+/* Blob coordinates of curve i as a cubic: p1, p2, pc, p3.  Quadratics
+ * repeat their control point. */
+static void
+get_quantized_points (const glyphy_curves_t &curves,
+                      unsigned int           i,
+                      int16_t                q[8])
+{
+  if (curves.cubic) {
+    curves.get_quantized_cubic (i, q);
+    return;
+  }
+  curves.get_quantized (i, q);
+  q[6] = q[4]; q[7] = q[5];
+  q[4] = q[2]; q[5] = q[3];
+}
 
-    /* Horizontal lines never intersect horizontal rays;
-     * vertical lines never intersect vertical rays. */
+/* Whether the curve with blob coordinates q is a line there. */
+static bool
+quantized_is_line (const int16_t q[8])
+{
+  return on_segment (q, q + 2, q + 6) && on_segment (q, q + 4, q + 6);
+}
+
+/* GLYPHY_FLAG_SIMPLIFY: drop curves that quantize to a point, and
+ * merge consecutive lines whose joint quantizes onto the line between
+ * their outer ends.  Only double coordinates within rounding of the
+ * blob's change, so the blob describes the same outline. */
+static void
+simplify_curves (glyphy_curves_t &curves)
+{
+  unsigned int num_curves = curves.size ();
+  unsigned int n = 0;
+  int16_t last[8];
 
-    for (int b = info.hband_lo; b <= info.hband_hi; b++) {
-      unsigned int index = hband_cursors[b]++;
-      hband_curves[index] = i;
-      hband_curves_asc[index] = i;
+  for (unsigned int i = 0; i < num_curves; i++) {
+    int16_t q[8];
+    get_quantized_points (curves, i, q);
+    bool joined = n && curves.joins (n - 1, i);
+
+    bool collapsed = true;
+    for (unsigned int k = 2; k < 8; k += 2)
+      collapsed &= q[k] == q[0] && q[k + 1] == q[1];
+    if (collapsed) {
+      /* Keep the contour joined to the curves that follow. */
+      if (joined)
+        curves.set_end (n - 1, i);
+      continue;
     }
 
-    for (int b = info.vband_lo; b <= info.vband_hi; b++) {
-      unsigned int index = vband_cursors[b]++;
-      vband_curves[index] = i;
-      vband_curves_asc[index] = i;
+    if (joined && quantized_is_line (last) && quantized_is_line (q) &&
+        on_segment (last, q, q + 6)) {
+      curves.set_end (n - 1, i);
+      last[6] = q[6]; last[7] = q[7];
+      continue;
     }
+
+    if (n != i)
+      curves.move (i, n);
+    memcpy (last, q, sizeof (last));
+    n++;
   }
 
-  /* Build two sort orders per band for symmetric optimization.
-   * Descending max: for rightward/upward ray (current behavior).
-   * Ascending min: for leftward/downward ray. */
-  for (unsigned int b = 0; b < num_hbands; b++) {
-    unsigned int off = hband_offsets[b];
-    unsigned int count = hband_curve_counts[b];
-    std::sort (hband_curves.begin () + off, hband_curves.begin () + off + count,
-               [&] (unsigned int a, unsigned int b) {
-                 return curve_infos[a].max_x > curve_infos[b].max_x;
-               });
-    std::sort (hband_curves_asc.begin () + off, hband_curves_asc.begin () + off + count,
-               [&] (unsigned int a, unsigned int b) {
-                 return curve_infos[a].min_x < curve_infos[b].min_x;
-               });
-  }
-
-  for (unsigned int b = 0; b < num_vbands; b++) {
-    unsigned int off = vband_offsets[b];
-    unsigned int count = vband_curve_counts[b];
-    std::sort (vband_curves.begin () + off, vband_curves.begin () + off + count,
-               [&] (unsigned int a, unsigned int b) {
-                 return curve_infos[a].max_y > curve_infos[b].max_y;
-               });
-    std::sort (vband_curves_asc.begin () + off, vband_curves_asc.begin () + off + count,
-               [&] (unsigned int a, unsigned int b) {
-                 return curve_infos[a].min_y < curve_infos[b].min_y;
-               });
-  }
-
-  /* Compute sizes -- two index lists per band */
-  unsigned int total_curve_indices = (total_hband_indices + total_vband_indices) * 2;
+  curves.truncate (n);
+}
+
+/* GLYPHY_FLAG_SINGLE_AXIS: keep the axis whose bands hold fewer curves
+ * each on average, and leave the other with no bands. */
+static void
+drop_axis (glyphy_bands_scratch_t *hbands,
+           glyphy_bands_scratch_t *vbands)
+{
+  unsigned long hsum = 0, vsum = 0;
+  for (unsigned int b = 0; b < hbands->num_bands; b++)
+    hsum += hbands->curve_counts[b];
+  for (unsigned int b = 0; b < vbands->num_bands; b++)
+    vsum += vbands->curve_counts[b];
+
+  glyphy_bands_scratch_t *drop = vsum * hbands->num_bands < hsum * vbands->num_bands ? hbands : vbands;
+  drop->num_bands = 0;
+  drop->index_len = 0;
+  drop->edge_len = 0;
+  drop->edges.clear ();
+}
+
+static void
+drop_sub_axis (glyphy_sub_bands_scratch_t *hsub,
+               glyphy_sub_bands_scratch_t *vsub)
+{
+  unsigned long hsum = 0, vsum = 0;
+  for (unsigned int c = 0; c < hsub->num_cells; c++)
+    hsum += hsub->cell_counts[c];
+  for (unsigned int c = 0; c < vsub->num_cells; c++)
+    vsum += vsub->cell_counts[c];
+
+  glyphy_sub_bands_scratch_t *drop = vsum * hsub->num_cells < hsum * vsub->num_cells ? hsub : vsub;
+  drop->num_bands = 0;
+  drop->num_cells = 0;
+  drop->index_len = 0;
+}
+
+/* Sub-bands: bands per axis, per curve, and at most.  Thinner bands
+ * have fewer curves ending within them, but more curves cross several
+ * bands and take a list entry in each. */
+#define GLYPHY_SUB_BANDS_PER_CURVE (1. / 16)
+#define GLYPHY_SUB_BANDS_MAX 1024
+
+/* The part of compute_layout() for sub-bands.  other_len is the length
+ * of the blob header and curve data. */
+static void
+compute_sub_band_layout (glyphy_t     *g,
+                         unsigned int  other_len)
+{
+  const glyphy_curves_t &curves = encode_curves (g);
+  glyphy_scratch_t &scratch = g->scratch;
+  const glyphy_extents_t *extents = &scratch.extents;
+  const glyphy_curve_info_t *curve_infos = scratch.curve_infos.data ();
+
+  if (scratch.keep_layout) {
+    /* A dropped axis stays dropped. */
+    if (scratch.hsub.num_bands)
+      glyphy_build_sub_bands (curves, curve_infos, *extents, false, scratch.hsub.num_bands,
+                              scratch.hsub, true);
+    if (scratch.vsub.num_bands)
+      glyphy_build_sub_bands (curves, curve_infos, *extents, true, scratch.vsub.num_bands,
+                              scratch.vsub, true);
+  } else {
+    unsigned int num_bands = std::max (std::min ((unsigned int) (curves.size () * GLYPHY_SUB_BANDS_PER_CURVE),
+                                                 (unsigned int) GLYPHY_SUB_BANDS_MAX),
+                                       (unsigned int) GLYPHY_DEFAULT_MAX_BANDS);
+    glyphy_build_sub_bands (curves, curve_infos, *extents, false, num_bands, scratch.hsub);
+    glyphy_build_sub_bands (curves, curve_infos, *extents, true, num_bands, scratch.vsub);
+    if (g->flags & GLYPHY_FLAG_SINGLE_AXIS)
+      drop_sub_axis (&scratch.hsub, &scratch.vsub);
+
+    scratch.cell_grid_len = 0;
+    if ((g->flags & GLYPHY_FLAG_CELL_GRID) &&
+        glyphy_classify_cells (curves, curve_infos, *extents, scratch.cells))
+      scratch.cell_grid_len = GLYPHY_CELL_GRID_SIZE * GLYPHY_CELL_GRID_SIZE / 32;
+  }
+
+  /* Sub-cell headers and index lists take the place of index lists. */
+  const glyphy_sub_bands_scratch_t *axes[2] = {&scratch.hsub, &scratch.vsub};
+  unsigned int band_headers_len = 0;
+  unsigned int total_curve_indices = 0;
+  bool fits = true;
+  for (unsigned int axis = 0; axis < 2; axis++) {
+    const glyphy_sub_bands_scratch_t *sub = axes[axis];
+    band_headers_len += sub->num_bands;
+    total_curve_indices += sub->num_cells + sub->index_len;
+    for (unsigned int c = 0; c < sub->num_cells; c++)
+      fits = fits &&
+             sub->cell_counts[c] <= (unsigned int) std::numeric_limits<int16_t>::max () &&
+             abs (sub->cell_windings[c]) <= std::numeric_limits<int16_t>::max ();
+  }
+  scratch.total_curve_indices = total_curve_indices;
+  scratch.blob_len = other_len + band_headers_len + scratch.cell_grid_len + total_curve_indices;
+
+  /* Offsets are 32-bit; only counts and the cell grid offset are
+   * 16-bit. */
+  scratch.encodable = fits &&
+                      glyphy_quantize_fits_i16 (extents->min_x) &&
+                      glyphy_quantize_fits_i16 (extents->min_y) &&
+                      glyphy_quantize_fits_i16 (extents->max_x) &&
+                      glyphy_quantize_fits_i16 (extents->max_y);
+  scratch.layout_valid = true;
+}
+
+/* Lay out the current curves.  With scratch.keep_layout, keep the
+ * extents, band counts, edges and splits, sub-cells, cell grid and
+ * dropped axis of the last layout, and only rebuild the lists. */
+static void
+compute_layout (glyphy_t *g)
+{
+  const glyphy_curves_t &curves = encode_curves (g);
+  unsigned int num_curves = curves.size ();
+
+  glyphy_scratch_t &scratch = g->scratch;
+  glyphy_extents_t *extents = &scratch.extents;
+  std::vector<glyphy_curve_info_t> &curve_infos = scratch.curve_infos;
+  curve_infos.resize (num_curves);
+  glyphy_extents_t curve_extents;
+  glyphy_compute_curve_bounds (curves, curve_infos.data (), &curve_extents);
+  bool keep = scratch.keep_layout;
+  if (!keep)
+    *extents = curve_extents;
 
   unsigned int header_len = 2; /* blob header: extents + band counts */
-  /* Compute curve data size with shared endpoints.
-   * Adjacent curves in a contour share p3/p1: N+1 texels per contour.
-   * Layout per contour: (p1,p2) (p3/p1,p2) ... (p3,0)
-   * The shader reads curveLoc and curveLoc+1, same as before. */
-  unsigned int num_contour_breaks = 0;
-  for (unsigned int i = 0; i + 1 < num_curves; i++)
-    if (curves[i].p3.x != curves[i + 1].p1.x ||
-        curves[i].p3.y != curves[i + 1].p1.y)
-      num_contour_breaks++;
-
-  /* With sharing: num_curves + (num_contour_breaks + 1) texels
-   * (one extra texel per contour for the final p3). */
-  unsigned int curve_data_len = num_curves + num_contour_breaks + 1;
+  unsigned int curve_data_len;
+  if (curves.cubic)
+    /* Cubics take two texels each, shared with no other curve. */
+    curve_data_len = 2 * num_curves;
+  else {
+    /* Compute curve data size with shared endpoints.
+     * Adjacent curves in a contour share p3/p1: N+1 texels per contour.
+     * Layout per contour: (p1,p2) (p3/p1,p2) ... (p3,0)
+     * The shader reads curveLoc and curveLoc+1, same as before. */
+    unsigned int num_contour_breaks = 0;
+    for (unsigned int i = 0; i + 1 < num_curves; i++)
+      if (!curves.continues (i))
+        num_contour_breaks++;
+
+    /* With sharing: num_curves + (num_contour_breaks + 1) texels
+     * (one extra texel per contour for the final p3). */
+    curve_data_len = num_curves + num_contour_breaks + 1;
+  }
 
-  unsigned int band_headers_len = num_hbands + num_vbands;
-  unsigned int total_len = header_len + band_headers_len + total_curve_indices + curve_data_len;
+  if (!keep)
+    scratch.sub_bands = (g->flags & GLYPHY_FLAG_SUB_BANDS) ||
+                         num_curves >= GLYPHY_SUB_BANDS_MIN_CURVES;
+  if (scratch.sub_bands) {
+    compute_sub_band_layout (g, header_len + curve_data_len);
+    return;
+  }
 
-  if (total_len > blob_size)
-    return false;
+  if (keep) {
+    /* A dropped axis stays dropped. */
+    if (scratch.hbands.num_bands)
+      build_bands (&scratch.hbands, curve_infos, extents, false, scratch.hbands.num_bands,
+                   g->flags, true);
+    if (scratch.vbands.num_bands)
+      build_bands (&scratch.vbands, curve_infos, extents, true, scratch.vbands.num_bands,
+                   g->flags, true);
+  } else {
+    /* Choose number of bands */
+    unsigned int num_hbands, num_vbands;
+    if (g->flags & GLYPHY_FLAG_ADAPTIVE_BANDS)
+      choose_band_counts (g, header_len + curve_data_len,
+                          &num_hbands, &num_vbands);
+    else {
+      num_hbands = std::max (std::min (num_curves, (unsigned int) GLYPHY_DEFAULT_MAX_BANDS), 1u);
+      num_vbands = num_hbands;
+    }
+
+    build_bands (&scratch.hbands, curve_infos, extents, false, num_hbands, g->flags);
+    build_bands (&scratch.vbands, curve_infos, extents, true, num_vbands, g->flags);
+    if (g->flags & GLYPHY_FLAG_SINGLE_AXIS)
+      drop_axis (&scratch.hbands, &scratch.vbands);
+
+    scratch.cell_grid_len = 0;
+    if ((g->flags & GLYPHY_FLAG_CELL_GRID) &&
+        glyphy_classify_cells (curves, curve_infos.data (), *extents, scratch.cells))
+      scratch.cell_grid_len = GLYPHY_CELL_GRID_SIZE * GLYPHY_CELL_GRID_SIZE / 32;
+  }
+
+  unsigned int total_curve_indices = scratch.hbands.index_len + scratch.vbands.index_len;
+  unsigned int band_headers_len = scratch.hbands.num_bands + scratch.vbands.num_bands;
+  unsigned int band_edges_len = scratch.hbands.edge_len + scratch.vbands.edge_len;
+
+  unsigned int total_len = header_len + band_headers_len + band_edges_len +
+                           scratch.cell_grid_len + total_curve_indices + curve_data_len;
+
+  scratch.total_curve_indices = total_curve_indices;
+  scratch.blob_len = total_len;
 
   /* Offsets and counts are stored in signed 16-bit lanes in the atlas. */
-  if (total_len - 1 > (unsigned int) std::numeric_limits<int16_t>::max ())
-    return false;
+  scratch.encodable = total_len - 1 <= (unsigned int) std::numeric_limits<int16_t>::max () &&
+                      glyphy_quantize_fits_i16 (extents->min_x) &&
+                      glyphy_quantize_fits_i16 (extents->min_y) &&
+                      glyphy_quantize_fits_i16 (extents->max_x) &&
+                      glyphy_quantize_fits_i16 (extents->max_y);
+  scratch.layout_valid = true;
+}
+
+/* Rework the curves as the flags ask, before laying them out.
+ *
+ * Simplifying leaves the outline alone, but would change the layout
+ * built on it: dropped and merged curves move band counts, balanced
+ * edges and splits, and with them which ray each pixel casts.  So lay
+ * out the curves as drawn first, and have compute_layout() keep that
+ * for the simplified curves, which then render the same.
+ *
+ * The rework goes into a copy, and the accumulated curves stay as
+ * drawn, so that encoding again after a change of settings starts over
+ * from them. */
+static void
+prepare_curves (glyphy_t *g)
+{
+  glyphy_scratch_t &scratch = g->scratch;
+  scratch.keep_layout = false;
+  scratch.reworked = g->flags & (GLYPHY_FLAG_REMOVE_OVERLAPS | GLYPHY_FLAG_SIMPLIFY);
+  if (scratch.reworked) {
+    scratch.prepared = g->curves;
+    if (g->flags & GLYPHY_FLAG_REMOVE_OVERLAPS)
+      glyphy_remove_overlaps (scratch.prepared, scratch.overlap);
+    if ((g->flags & GLYPHY_FLAG_SIMPLIFY) && !scratch.prepared.empty ()) {
+      compute_layout (g);
+      simplify_curves (scratch.prepared);
+      scratch.keep_layout = true;
+      scratch.layout_valid = false;
+    }
+  }
+  g->num_curves = encode_curves (g).size ();
+}
+
+glyphy_bool_t
+glyphy_encode_size (glyphy_t     *g,
+                    unsigned int *output_len)
+{
+  if (!g->scratch.layout_valid)
+    prepare_curves (g);
+
+  if (encode_curves (g).empty ()) {
+    *output_len = 0;
+    return true;
+  }
+
+  if (!g->scratch.layout_valid)
+    compute_layout (g);
+
+  *output_len = g->scratch.blob_len;
+  return g->scratch.encodable;
+}
+
+
+/*
+ * Encode accumulated curves into blob
+ */
+
+glyphy_bool_t
+glyphy_encode (glyphy_t         *g,
+               glyphy_texel_t   *blob,
+               unsigned int      blob_size,
+               unsigned int     *output_len,
+               glyphy_extents_t *extents)
+{
+  if (!g->scratch.layout_valid)
+    prepare_curves (g);
+
+  const glyphy_curves_t &curves = encode_curves (g);
+  unsigned int num_curves = curves.size ();
+
+  if (num_curves == 0) {
+    glyphy_extents_clear (extents);
+    *output_len = 0;
+    return true;
+  }
+
+  glyphy_scratch_t &scratch = g->scratch;
+  if (!scratch.layout_valid)
+    compute_layout (g);
 
-  if (!quantize_fits_i16 (extents->min_x) ||
-      !quantize_fits_i16 (extents->min_y) ||
-      !quantize_fits_i16 (extents->max_x) ||
-      !quantize_fits_i16 (extents->max_y))
+  *extents = scratch.extents;
+  if (!scratch.encodable || scratch.blob_len > blob_size)
     return false;
 
-  unsigned int curve_data_offset = header_len + band_headers_len + total_curve_indices;
+  const std::vector<glyphy_curve_info_t> &curve_infos = scratch.curve_infos;
+  const glyphy_bands_scratch_t *axes[2] = {&scratch.hbands, &scratch.vbands};
+  bool sub_bands = scratch.sub_bands;
+  unsigned int num_hbands = sub_bands ? scratch.hsub.num_bands : scratch.hbands.num_bands;
+  unsigned int num_vbands = sub_bands ? scratch.vsub.num_bands : scratch.vbands.num_bands;
+  unsigned int total_curve_indices = scratch.total_curve_indices;
+  unsigned int total_len = scratch.blob_len;
+  unsigned int header_len = 2;
+  unsigned int band_headers_len = num_hbands + num_vbands;
+  unsigned int band_edges_len = sub_bands ? 0 : scratch.hbands.edge_len + scratch.vbands.edge_len;
+  unsigned int cell_grid_offset = header_len + band_headers_len + band_edges_len;
+  unsigned int cell_grid_len = scratch.cell_grid_len;
+
+  unsigned int curve_data_offset = cell_grid_offset + cell_grid_len + total_curve_indices;
+  bool bounded = !sub_bands && (g->flags & GLYPHY_FLAG_BOUNDED_INDICES);
+  bool balanced = !sub_bands && (g->flags & GLYPHY_FLAG_BALANCED_BANDS);
 
   /* Pack blob header */
-  blob[0].r = quantize (extents->min_x);
-  blob[0].g = quantize (extents->min_y);
-  blob[0].b = quantize (extents->max_x);
-  blob[0].a = quantize (extents->max_y);
+  blob[0].r = glyphy_quantize (extents->min_x);
+  blob[0].g = glyphy_quantize (extents->min_y);
+  blob[0].b = glyphy_quantize (extents->max_x);
+  blob[0].a = glyphy_quantize (extents->max_y);
   blob[1].r = (int16_t) num_hbands;
   blob[1].g = (int16_t) num_vbands;
-  blob[1].b = 0;
-  blob[1].a = 0;
-
-  /* Pack curve data with shared endpoints.
+  blob[1].b = (bounded ? GLYPHY_BLOB_FLAG_BOUNDED_INDICES : 0) |
+              (balanced ? GLYPHY_BLOB_FLAG_BALANCED_BANDS : 0) |
+              (curves.cubic ? GLYPHY_BLOB_FLAG_CUBICS : 0) |
+              (cell_grid_len ? GLYPHY_BLOB_FLAG_CELL_GRID : 0) |
+              (sub_bands ? GLYPHY_BLOB_FLAG_SUB_BANDS : 0);
+  blob[1].a = cell_grid_len ? (int16_t) cell_grid_offset : 0;
+
+  /* Pack curve data, quadratics with shared endpoints.
    * Build curve_texel_offset[i] = texel offset for curve i's first texel. */
-  std::vector<unsigned int> curve_texel_offset;
+  std::vector<unsigned int> &curve_texel_offset = scratch.curve_texel_offset;
   curve_texel_offset.resize (num_curves);
   unsigned int texel = curve_data_offset;
 
-  for (unsigned int i = 0; i < num_curves; i++) {
-    bool contour_start = (i == 0 ||
-                          curves[i - 1].p3.x != curves[i].p1.x ||
-                          curves[i - 1].p3.y != curves[i].p1.y);
-
-    if (contour_start) {
-      curve_texel_offset[i] = texel;
-      /* First curve in contour: write (p1, p2) */
-      blob[texel].r = quantize (curves[i].p1.x);
-      blob[texel].g = quantize (curves[i].p1.y);
-      blob[texel].b = quantize (curves[i].p2.x);
-      blob[texel].a = quantize (curves[i].p2.y);
-      texel++;
-    } else {
-      /* Non-start curve: p12 is in the previous texel (p3_prev, p2) */
-      curve_texel_offset[i] = texel - 1;
-    }
+  if (curves.cubic)
+    pack_cubics (blob, texel, curves, curve_texel_offset.data ());
+  else {
+    int16_t q[6], next_q[6];
+    curves.get_quantized (0, next_q);
+    mark_line (next_q);
+    for (unsigned int i = 0; i < num_curves; i++) {
+      memcpy (q, next_q, sizeof (q));
+      bool contour_start = i == 0 || !curves.continues (i - 1);
+
+      if (contour_start) {
+        curve_texel_offset[i] = texel;
+        /* First curve in contour: write (p1, p2) */
+        blob[texel].r = q[0];
+        blob[texel].g = q[1];
+        blob[texel].b = q[2];
+        blob[texel].a = q[3];
+        texel++;
+      } else {
+        /* Non-start curve: p12 is in the previous texel (p3_prev, p2) */
+        curve_texel_offset[i] = texel - 1;
+      }
 
-    /* Write (p3, p2_next) or (p3, 0) if last in contour */
-    bool has_next = (i + 1 < num_curves &&
-                     curves[i].p3.x == curves[i + 1].p1.x &&
-                     curves[i].p3.y == curves[i + 1].p1.y);
+      /* Write (p3, p2_next) or (p3, 0) if last in contour */
+      if (i + 1 < num_curves) {
+        curves.get_quantized (i + 1, next_q);
+        mark_line (next_q);
+      }
+      bool has_next = i + 1 < num_curves && curves.continues (i);
 
-    blob[texel].r = quantize (curves[i].p3.x);
-    blob[texel].g = quantize (curves[i].p3.y);
-    if (has_next) {
-      blob[texel].b = quantize (curves[i + 1].p2.x);
-      blob[texel].a = quantize (curves[i + 1].p2.y);
-    } else {
-      blob[texel].b = 0;
-      blob[texel].a = 0;
+      blob[texel].r = q[4];
+      blob[texel].g = q[5];
+      if (has_next) {
+        blob[texel].b = next_q[2];
+        blob[texel].a = next_q[3];
+      } else {
+        blob[texel].b = 0;
+        blob[texel].a = 0;
+      }
+      texel++;
     }
-    texel++;
   }
 
-  /* Pack band headers and curve indices.
+  /* Pack band headers and curve indices, h-bands first.
    * Band header: (count, desc_offset, asc_offset, split_value)
    * All offsets are relative to blob start. */
-  unsigned int index_offset = header_len + band_headers_len;
-
-  for (unsigned int b = 0; b < num_hbands; b++) {
-    /* Per-band split: find x that minimizes max(left_count, right_count).
-     * Curves with max_x >= split are processed by rightward ray.
-     * Curves with min_x <= split are processed by leftward ray.
-     * Descending sort is by max_x, so try split at each max_x boundary. */
-    int16_t hband_split;
-    {
-      unsigned int off = hband_offsets[b];
-      unsigned int n = hband_curve_counts[b];
-      unsigned int best_worst = n;
-      double best_split = (extents->min_x + extents->max_x) * 0.5;
-      unsigned int left_count = n;
-      for (unsigned int ci = 0; ci < n; ci++) {
-        double split = curve_infos[hband_curves[off + ci]].max_x;
-        unsigned int right_count = ci + 1; /* curves with max_x >= split */
-        while (left_count &&
-               curve_infos[hband_curves_asc[off + left_count - 1]].min_x > split)
-          left_count--;
-        unsigned int worst = std::max (right_count, left_count);
-        if (worst < best_worst) {
-          best_worst = worst;
-          best_split = split;
-        }
-      }
-      hband_split = quantize (best_split);
-    }
-    unsigned int hdr = header_len + b;
-    unsigned int desc_off = index_offset;
-
-    for (unsigned int ci = 0; ci < hband_curve_counts[b]; ci++) {
-      blob[index_offset].r = (int16_t) curve_texel_offset[hband_curves[hband_offsets[b] + ci]];
-      blob[index_offset].g = 0;
-      blob[index_offset].b = 0;
-      blob[index_offset].a = 0;
-      index_offset++;
-    }
+  unsigned int hdr = header_len;
+  unsigned int index_offset = cell_grid_offset + cell_grid_len;
 
-    unsigned int asc_off = index_offset;
+  if (balanced) {
+    unsigned int offset = header_len + band_headers_len;
+    for (unsigned int axis = 0; axis < 2; axis++)
+      offset = pack_band_edges (blob, offset, axes[axis]);
+  }
 
-    for (unsigned int ci = 0; ci < hband_curve_counts[b]; ci++) {
-      blob[index_offset].r = (int16_t) curve_texel_offset[hband_curves_asc[hband_offsets[b] + ci]];
-      blob[index_offset].g = 0;
-      blob[index_offset].b = 0;
-      blob[index_offset].a = 0;
-      index_offset++;
-    }
+  if (cell_grid_len)
+    pack_cell_grid (blob, cell_grid_offset, scratch.cells.cells);
 
-    blob[hdr].r = (int16_t) hband_curve_counts[b];
-    blob[hdr].g = (int16_t) desc_off;
-    blob[hdr].b = (int16_t) asc_off;
-    blob[hdr].a = hband_split;
+  if (sub_bands) {
+    const glyphy_sub_bands_scratch_t *subs[2] = {&scratch.hsub, &scratch.vsub};
+    for (unsigned int axis = 0; axis < 2; axis++)
+      index_offset = pack_sub_bands (blob, &hdr, index_offset, subs[axis],
+                                     curve_texel_offset.data ());
+    *output_len = total_len;
+    return true;
   }
 
-  for (unsigned int b = 0; b < num_vbands; b++) {
-    int16_t vband_split;
-    {
-      unsigned int off = vband_offsets[b];
-      unsigned int n = vband_curve_counts[b];
-      unsigned int best_worst = n;
-      double best_split = (extents->min_y + extents->max_y) * 0.5;
-      unsigned int left_count = n;
-      for (unsigned int ci = 0; ci < n; ci++) {
-        double split = curve_infos[vband_curves[off + ci]].max_y;
-        unsigned int right_count = ci + 1;
-        while (left_count &&
-               curve_infos[vband_curves_asc[off + left_count - 1]].min_y > split)
-          left_count--;
-        unsigned int worst = std::max (right_count, left_count);
-        if (worst < best_worst) {
-          best_worst = worst;
-          best_split = split;
-        }
+  for (unsigned int axis = 0; axis < 2; axis++) {
+    const glyphy_bands_scratch_t *bands = axes[axis];
+
+    for (unsigned int b = 0; b < bands->num_bands; b++) {
+      const unsigned int *desc = &bands->curves[bands->offsets[b]];
+      const unsigned int *asc = &bands->curves_asc[bands->offsets[b]];
+      unsigned int count = bands->curve_counts[b];
+      unsigned int desc_off = index_offset;
+      unsigned int asc_off;
+
+      if (bounded) {
+        index_offset = pack_bounded_index_list (blob, index_offset, desc, count,
+                                                curve_texel_offset.data (),
+                                                curve_infos.data (), axis == 1, false);
+        asc_off = index_offset;
+        index_offset = pack_bounded_index_list (blob, index_offset, asc, count,
+                                                curve_texel_offset.data (),
+                                                curve_infos.data (), axis == 1, true);
+      } else {
+        index_offset = pack_index_list (blob, index_offset, desc, count,
+                                        curve_texel_offset.data ());
+        asc_off = index_offset;
+        index_offset = pack_index_list (blob, index_offset, asc, count,
+                                        curve_texel_offset.data ());
       }
-      vband_split = quantize (best_split);
+
+      blob[hdr].r = (int16_t) count;
+      blob[hdr].g = (int16_t) desc_off;
+      blob[hdr].b = (int16_t) asc_off;
+      blob[hdr].a = glyphy_quantize (bands->splits[b]);
+      hdr++;
     }
+  }
 
-    unsigned int hdr = header_len + num_hbands + b;
-    unsigned int desc_off = index_offset;
+  *output_len = total_len;
 
-    for (unsigned int ci = 0; ci < vband_curve_counts[b]; ci++) {
-      blob[index_offset].r = (int16_t) curve_texel_offset[vband_curves[vband_offsets[b] + ci]];
-      blob[index_offset].g = 0;
-      blob[index_offset].b = 0;
-      blob[index_offset].a = 0;
-      index_offset++;
-    }
+  return true;
+}
 
-    unsigned int asc_off = index_offset;
 
-    for (unsigned int ci = 0; ci < vband_curve_counts[b]; ci++) {
-      blob[index_offset].r = (int16_t) curve_texel_offset[vband_curves_asc[vband_offsets[b] + ci]];
-      blob[index_offset].g = 0;
-      blob[index_offset].b = 0;
-      blob[index_offset].a = 0;
-      index_offset++;
-    }
+/*
+ * Encode a batch of glyphs into one buffer
+ */
 
-    blob[hdr].r = (int16_t) vband_curve_counts[b];
-    blob[hdr].g = (int16_t) desc_off;
-    blob[hdr].b = (int16_t) asc_off;
-    blob[hdr].a = vband_split;
+unsigned int
+glyphy_encode_batch (glyphy_t                      *g,
+                     glyphy_get_glyph_shape_func_t  get_glyph_shape,
+                     void                          *user_data,
+                     const unsigned int            *glyphs,
+                     unsigned int                   num_glyphs,
+                     glyphy_texel_t                *buffer,
+                     unsigned int                   buffer_size,
+                     unsigned int                  *output_len,
+                     glyphy_glyph_blob_t           *blobs)
+{
+  unsigned int offset = 0;
+  unsigned int i;
+
+  for (i = 0; i < num_glyphs; i++)
+  {
+    glyphy_glyph_blob_t *blob = &blobs[i];
+
+    glyphy_reset (g);
+    if (!get_glyph_shape (g, glyphs[i], user_data) ||
+        !glyphy_successful (g))
+      break;
+
+    if (!glyphy_encode (g,
+                        buffer + offset, buffer_size - offset,
+                        &blob->length,
+                        &blob->extents))
+      break;
+
+    blob->offset = offset;
+    blob->num_curves = glyphy_get_num_curves (g);
+    blob->failed = false;
+    offset += blob->length;
   }
 
-  *output_len = total_len;
-
-  return true;
+  *output_len = offset;
+  return i;
 }
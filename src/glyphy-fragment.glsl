@@ -15,6 +15,23 @@
 
 #define GLYPHY_INV_UNITS float(1.0 / float(GLYPHY_UNITS_PER_EM_UNIT))
 
+/* Blob format flags, in blob header texel 1, lane B */
+#define GLYPHY_BLOB_FLAG_BOUNDED_INDICES 1
+#define GLYPHY_BLOB_FLAG_BALANCED_BANDS  2
+#define GLYPHY_BLOB_FLAG_CUBICS          4
+#define GLYPHY_BLOB_FLAG_CELL_GRID       8
+#define GLYPHY_BLOB_FLAG_SUB_BANDS       16
+
+/* Cells per axis of the cell grid; must match the encoder's */
+#ifndef GLYPHY_CELL_GRID_SIZE
+#define GLYPHY_CELL_GRID_SIZE 16
+#endif
+
+/* Root refinement steps for cubics */
+#ifndef GLYPHY_CUBIC_ITERATIONS
+#define GLYPHY_CUBIC_ITERATIONS 8
+#endif
+
 
 uniform isamplerBuffer u_atlas;
 
@@ -67,6 +84,17 @@ vec2 _glyphy_solve_vert_poly (vec4 p12, vec2 p3)
 	       (a.y * t2 - b.y * 2.0) * t2 + p12.y);
 }
 
+/* Lines have p2 == p1; their one crossing needs no square root. */
+float _glyphy_solve_horiz_line (vec2 p1, vec2 p3)
+{
+  return p1.x + (p3.x - p1.x) * (p1.y / (p1.y - p3.y));
+}
+
+float _glyphy_solve_vert_line (vec2 p1, vec2 p3)
+{
+  return p1.y + (p3.y - p1.y) * (p1.x / (p1.x - p3.x));
+}
+
 float _glyphy_calc_coverage (float xcov, float ycov, float xwgt, float ywgt)
 {
   float coverage = max (abs (xcov * xwgt + ycov * ywgt) /
@@ -76,132 +104,503 @@ float _glyphy_calc_coverage (float xcov, float ycov, float xwgt, float ywgt)
   return clamp (coverage, 0.0, 1.0);
 }
 
-/* Render a glyph and return its coverage in [0, 1].
+/* Cubic curves (GLYPHY_BLOB_FLAG_CUBICS) are monotonic in x and y, so
+ * a ray crosses each at most once, where its end points lie on either
+ * side.  Classify the crossing like that of the line between the ends,
+ * then find it with Newton steps, kept inside a shrinking bracket. */
+
+/* Parameter in [0, 1] where the cubic with coordinates c crosses zero;
+ * c.x and c.w must differ in sign. */
+float _glyphy_solve_monotonic_cubic (vec4 c)
+{
+  float a = c.w - c.x + 3.0 * (c.y - c.z);
+  float b = 3.0 * (c.x - 2.0 * c.y + c.z);
+  float d = 3.0 * (c.y - c.x);
+
+  bool rising = c.x < c.w;
+  float lo = 0.0;
+  float hi = 1.0;
+  float t = clamp (c.x / (c.x - c.w), 0.0, 1.0);
+  for (int i = 0; i < GLYPHY_CUBIC_ITERATIONS; i++)
+  {
+    float f = ((a * t + b) * t + d) * t + c.x;
+    if ((f < 0.0) == rising) lo = t; else hi = t;
+    float df = (3.0 * a * t + 2.0 * b) * t + d;
+    float next = t - f / df;
+    t = (next >= lo && next <= hi) ? next : (lo + hi) * 0.5;
+  }
+  return t;
+}
+
+float _glyphy_eval_cubic (vec4 c, float t)
+{
+  float s = 1.0 - t;
+  return s * s * (s * c.x + 3.0 * t * c.y) + t * t * (3.0 * s * c.z + t * c.w);
+}
+
+/* Same as _glyphy_horiz_curve(), for a cubic. */
+bool _glyphy_horiz_cubic (int curveLoc, vec2 renderCoord, float pixelsPerEm,
+			  bool leftRay, inout float xcov, inout float xwgt)
+{
+  ivec4 raw12 = texelFetch (u_atlas, curveLoc);
+  ivec4 raw34 = texelFetch (u_atlas, curveLoc + 1);
+
+  vec4 p12 = vec4 (raw12) * GLYPHY_INV_UNITS - vec4 (renderCoord, renderCoord);
+  vec4 p34 = vec4 (raw34) * GLYPHY_INV_UNITS - vec4 (renderCoord, renderCoord);
+  vec4 xs = vec4 (p12.xz, p34.xz);
+  vec4 ys = vec4 (p12.yw, p34.yw);
+
+  if (leftRay) {
+    if (min (min (xs.x, xs.y), min (xs.z, xs.w)) * pixelsPerEm > 0.5) return false;
+  } else {
+    if (max (max (xs.x, xs.y), max (xs.z, xs.w)) * pixelsPerEm < -0.5) return false;
+  }
+
+  uint code = _glyphy_calc_root_code (ys.x, ys.x, ys.w);
+  if (code != 0U)
+  {
+    float r = (raw12.xy == raw12.zw && raw34.xy == raw34.zw
+	       ? _glyphy_solve_horiz_line (p12.xy, p34.zw)
+	       : _glyphy_eval_cubic (xs, _glyphy_solve_monotonic_cubic (ys))) * pixelsPerEm;
+    float cov = leftRay ? clamp (0.5 - r, 0.0, 1.0) : clamp (r + 0.5, 0.0, 1.0);
+    xcov += (code & 1U) != 0U ? cov : -cov;
+    xwgt = max (xwgt, clamp (1.0 - abs (r) * 2.0, 0.0, 1.0));
+  }
+
+  return true;
+}
+
+/* Same as _glyphy_vert_curve(), for a cubic. */
+bool _glyphy_vert_cubic (int curveLoc, vec2 renderCoord, float pixelsPerEm,
+			 bool leftRay, inout float ycov, inout float ywgt)
+{
+  ivec4 raw12 = texelFetch (u_atlas, curveLoc);
+  ivec4 raw34 = texelFetch (u_atlas, curveLoc + 1);
+
+  vec4 p12 = vec4 (raw12) * GLYPHY_INV_UNITS - vec4 (renderCoord, renderCoord);
+  vec4 p34 = vec4 (raw34) * GLYPHY_INV_UNITS - vec4 (renderCoord, renderCoord);
+  vec4 xs = vec4 (p12.xz, p34.xz);
+  vec4 ys = vec4 (p12.yw, p34.yw);
+
+  if (leftRay) {
+    if (min (min (ys.x, ys.y), min (ys.z, ys.w)) * pixelsPerEm > 0.5) return false;
+  } else {
+    if (max (max (ys.x, ys.y), max (ys.z, ys.w)) * pixelsPerEm < -0.5) return false;
+  }
+
+  uint code = _glyphy_calc_root_code (xs.x, xs.x, xs.w);
+  if (code != 0U)
+  {
+    float r = (raw12.xy == raw12.zw && raw34.xy == raw34.zw
+	       ? _glyphy_solve_vert_line (p12.xy, p34.zw)
+	       : _glyphy_eval_cubic (ys, _glyphy_solve_monotonic_cubic (xs))) * pixelsPerEm;
+    float cov = leftRay ? clamp (0.5 - r, 0.0, 1.0) : clamp (r + 0.5, 0.0, 1.0);
+    ycov += (code & 1U) != 0U ? -cov : cov;
+    ywgt = max (ywgt, clamp (1.0 - abs (r) * 2.0, 0.0, 1.0));
+  }
+
+  return true;
+}
+
+/* Add one curve's contribution to the horizontal-ray coverage.
+ * Returns false if the curve, and so every curve after it in the
+ * sorted list, lies entirely behind the ray. */
+bool _glyphy_horiz_curve (int curveLoc, vec2 renderCoord, float pixelsPerEm,
+			  bool leftRay, bool cubic, inout float xcov, inout float xwgt)
+{
+  if (cubic)
+    return _glyphy_horiz_cubic (curveLoc, renderCoord, pixelsPerEm, leftRay, xcov, xwgt);
+
+  ivec4 raw12 = texelFetch (u_atlas, curveLoc);
+  ivec4 raw3 = texelFetch (u_atlas, curveLoc + 1);
+
+  vec4 p12 = vec4 (raw12) * GLYPHY_INV_UNITS - vec4 (renderCoord, renderCoord);
+  vec2 p3 = vec2 (raw3.rg) * GLYPHY_INV_UNITS - renderCoord;
+
+  if (leftRay) {
+    if (min (min (p12.x, p12.z), p3.x) * pixelsPerEm > 0.5) return false;
+  } else {
+    if (max (max (p12.x, p12.z), p3.x) * pixelsPerEm < -0.5) return false;
+  }
+
+  uint code = _glyphy_calc_root_code (p12.y, p12.w, p3.y);
+  if (code != 0U && raw12.xy == raw12.zw)
+  {
+    /* A line crosses once, upward (code 0x100) or downward (code 1). */
+    float r = _glyphy_solve_horiz_line (p12.xy, p3) * pixelsPerEm;
+    float cov = leftRay ? clamp (0.5 - r, 0.0, 1.0) : clamp (r + 0.5, 0.0, 1.0);
+    xcov += (code & 1U) != 0U ? cov : -cov;
+    xwgt = max (xwgt, clamp (1.0 - abs (r) * 2.0, 0.0, 1.0));
+  }
+  else if (code != 0U)
+  {
+    vec2 r = _glyphy_solve_horiz_poly (p12, p3) * pixelsPerEm;
+    /* For leftward ray: saturate(0.5 - r) counts coverage from the left */
+    vec2 cov = leftRay ? clamp (vec2 (0.5) - r, 0.0, 1.0)
+		       : clamp (r + vec2 (0.5), 0.0, 1.0);
+
+    if ((code & 1U) != 0U)
+    {
+      xcov += cov.x;
+      xwgt = max (xwgt, clamp (1.0 - abs (r.x) * 2.0, 0.0, 1.0));
+    }
+
+    if (code > 1U)
+    {
+      xcov -= cov.y;
+      xwgt = max (xwgt, clamp (1.0 - abs (r.y) * 2.0, 0.0, 1.0));
+    }
+  }
+
+  return true;
+}
+
+/* Same as _glyphy_horiz_curve(), for the vertical ray. */
+bool _glyphy_vert_curve (int curveLoc, vec2 renderCoord, float pixelsPerEm,
+			 bool leftRay, bool cubic, inout float ycov, inout float ywgt)
+{
+  if (cubic)
+    return _glyphy_vert_cubic (curveLoc, renderCoord, pixelsPerEm, leftRay, ycov, ywgt);
+
+  ivec4 raw12 = texelFetch (u_atlas, curveLoc);
+  ivec4 raw3 = texelFetch (u_atlas, curveLoc + 1);
+
+  vec4 p12 = vec4 (raw12) * GLYPHY_INV_UNITS - vec4 (renderCoord, renderCoord);
+  vec2 p3 = vec2 (raw3.rg) * GLYPHY_INV_UNITS - renderCoord;
+
+  if (leftRay) {
+    if (min (min (p12.y, p12.w), p3.y) * pixelsPerEm > 0.5) return false;
+  } else {
+    if (max (max (p12.y, p12.w), p3.y) * pixelsPerEm < -0.5) return false;
+  }
+
+  uint code = _glyphy_calc_root_code (p12.x, p12.z, p3.x);
+  if (code != 0U && raw12.xy == raw12.zw)
+  {
+    float r = _glyphy_solve_vert_line (p12.xy, p3) * pixelsPerEm;
+    float cov = leftRay ? clamp (0.5 - r, 0.0, 1.0) : clamp (r + 0.5, 0.0, 1.0);
+    ycov += (code & 1U) != 0U ? -cov : cov;
+    ywgt = max (ywgt, clamp (1.0 - abs (r) * 2.0, 0.0, 1.0));
+  }
+  else if (code != 0U)
+  {
+    vec2 r = _glyphy_solve_vert_poly (p12, p3) * pixelsPerEm;
+    vec2 cov = leftRay ? clamp (vec2 (0.5) - r, 0.0, 1.0)
+		       : clamp (r + vec2 (0.5), 0.0, 1.0);
+
+    if ((code & 1U) != 0U)
+    {
+      ycov -= cov.x;
+      ywgt = max (ywgt, clamp (1.0 - abs (r.x) * 2.0, 0.0, 1.0));
+    }
+
+    if (code > 1U)
+    {
+      ycov += cov.y;
+      ywgt = max (ywgt, clamp (1.0 - abs (r.y) * 2.0, 0.0, 1.0));
+    }
+  }
+
+  return true;
+}
+
+/* Bounded index entry test: entry holds the curve's sort key along the
+ * ray and its min/max across it, all relative to the sample.  Same
+ * arithmetic as the curve helpers, so the results agree exactly. */
+bool _glyphy_entry_past (float key, float pixelsPerEm, bool leftRay)
+{
+  return leftRay ? key * pixelsPerEm > 0.5 : key * pixelsPerEm < -0.5;
+}
+
+/* Balanced bands: the band of coord is the number of band edges at or
+ * below it.  Edges are sorted and packed four per texel. */
+int _glyphy_find_band (int edgeLoc, int numBands, float coord)
+{
+  int band = 0;
+  for (int e = 0; e < numBands - 1; e += 4)
+  {
+    vec4 edges = vec4 (texelFetch (u_atlas, edgeLoc + (e >> 2))) * GLYPHY_INV_UNITS;
+    bvec4 below = lessThanEqual (edges, vec4 (coord));
+    band += int (dot (vec4 (below), vec4 (1.0)));
+    if (!below.w) break;
+  }
+  return min (band, numBands - 1);
+}
+
+/* Cell grid (GLYPHY_BLOB_FLAG_CELL_GRID): coverage of a sample half a
+ * pixel or more inside an empty or solid cell, or outside the extents,
+ * where every curve crossing is too far away to count partially; or
+ * -1.0 if the curves must be tested. */
+float _glyphy_cell_coverage (int gridLoc, vec4 ext, vec2 renderCoord, vec2 pixelsPerEm)
+{
+  /* Distance outside the extents, per axis */
+  vec2 outside = max (ext.xy - renderCoord, renderCoord - ext.zw) * pixelsPerEm;
+  if (any (greaterThanEqual (outside, vec2 (0.5))))
+    return 0.0;
+
+  vec2 cellSize = (ext.zw - ext.xy) / float (GLYPHY_CELL_GRID_SIZE);
+  vec2 cellCoord = (renderCoord - ext.xy) / cellSize;
+  ivec2 cell = ivec2 (floor (cellCoord));
+  vec2 f = cellCoord - vec2 (cell);
+  if (any (lessThan (min (f, 1.0 - f) * cellSize * pixelsPerEm, vec2 (0.5))) ||
+      any (lessThan (cell, ivec2 (0))) ||
+      any (greaterThanEqual (cell, ivec2 (GLYPHY_CELL_GRID_SIZE))))
+    return -1.0;
+
+  int index = cell.y * GLYPHY_CELL_GRID_SIZE + cell.x;
+  int lanes = texelFetch (u_atlas, gridLoc + (index >> 5))[(index >> 3) & 3];
+  int state = (lanes >> ((index & 7) * 2)) & 3;
+  return state == 0 ? -1.0 : float (state - 1);
+}
+
+/* Sub-bands (GLYPHY_BLOB_FLAG_SUB_BANDS) store offsets in two lanes,
+ * low half first. */
+int _glyphy_offset32 (ivec2 lanes)
+{
+  return (lanes.y << 16) | (lanes.x & 0xFFFF);
+}
+
+/* Coverage of a sample whose rays went along one axis only. */
+float _glyphy_calc_single_coverage (float cov)
+{
+  return clamp (abs (cov), 0.0, 1.0);
+}
+
+/* Sub-bands: each band is split along its rays into sub-cells.  A ray
+ * goes rightward, or upward, from the sample's sub-cell; the sub-cell
+ * holds the curves it must test, sorted for the break test, and the
+ * coverage the rest add. */
+float _glyphy_render_sub_bands (int glyphLoc, vec4 ext, vec4 bandTransform,
+				int numHBands, int numVBands, bool cubic, bool singleAxis,
+				vec2 renderCoord, vec2 pixelsPerEm)
+{
+  vec2 extSize = max (ext.zw - ext.xy, vec2 (GLYPHY_INV_UNITS));
+  ivec2 bandIndex = clamp (ivec2 (renderCoord * bandTransform.xy + bandTransform.zw),
+			   ivec2 (0, 0),
+			   max (ivec2 (numVBands - 1, numHBands - 1), ivec2 (0, 0)));
+
+  ivec4 hcell = ivec4 (0);
+  if (numHBands != 0)
+  {
+    ivec4 hband = texelFetch (u_atlas, glyphLoc + 2 + bandIndex.y);
+    int hCellIndex = clamp (int ((renderCoord.x - ext.x) * float (hband.r) / extSize.x), 0, hband.r - 1);
+    hcell = texelFetch (u_atlas, glyphLoc + _glyphy_offset32 (hband.gb) + hCellIndex);
+  }
+  ivec4 vcell = ivec4 (0);
+  if (numVBands != 0)
+  {
+    ivec4 vband = texelFetch (u_atlas, glyphLoc + 2 + numHBands + bandIndex.x);
+    int vCellIndex = clamp (int ((renderCoord.y - ext.y) * float (vband.r) / extSize.y), 0, vband.r - 1);
+    vcell = texelFetch (u_atlas, glyphLoc + _glyphy_offset32 (vband.gb) + vCellIndex);
+  }
+
+  /* For one axis, the one with fewer curves to test. */
+  bool doH = numHBands != 0 && (!singleAxis || numVBands == 0 || hcell.r <= vcell.r);
+  bool doV = numVBands != 0 && (!singleAxis || !doH);
+
+  float xcov = float (hcell.a);
+  float xwgt = 0.0;
+  int hListLoc = glyphLoc + _glyphy_offset32 (hcell.gb);
+  for (int ci = 0; doH && ci < hcell.r; ci++)
+  {
+    ivec4 entry = texelFetch (u_atlas, hListLoc + (ci >> 1));
+    int curveLoc = glyphLoc + _glyphy_offset32 ((ci & 1) == 0 ? entry.rg : entry.ba);
+    if (!_glyphy_horiz_curve (curveLoc, renderCoord, pixelsPerEm.x,
+			      false, cubic, xcov, xwgt)) break;
+  }
+
+  float ycov = float (vcell.a);
+  float ywgt = 0.0;
+  int vListLoc = glyphLoc + _glyphy_offset32 (vcell.gb);
+  for (int ci = 0; doV && ci < vcell.r; ci++)
+  {
+    ivec4 entry = texelFetch (u_atlas, vListLoc + (ci >> 1));
+    int curveLoc = glyphLoc + _glyphy_offset32 ((ci & 1) == 0 ? entry.rg : entry.ba);
+    if (!_glyphy_vert_curve (curveLoc, renderCoord, pixelsPerEm.y,
+			     false, cubic, ycov, ywgt)) break;
+  }
+
+  if (!doV)
+    return _glyphy_calc_single_coverage (xcov);
+  if (!doH)
+    return _glyphy_calc_single_coverage (ycov);
+  return _glyphy_calc_coverage (xcov, ycov, xwgt, ywgt);
+}
+
+/* Render a glyph from its blob header as decoded by glyphy_decode_header()
+ * in the vertex shader, and return its coverage in [0, 1].
  *
  * Requires the u_atlas uniform to be bound to the glyph atlas buffer.
  *
- * renderCoord:  em-space sample position (interpolated from vertex shader)
- * glyphLoc:     offset into u_atlas for this glyph's encoded blob
+ * renderCoord:     em-space sample position (interpolated from vertex shader)
+ * glyphLoc:        offset into u_atlas for this glyph's encoded blob
+ * ext, bandTransform, header:
+ *                  outputs of glyphy_decode_header() for glyphLoc
+ * singleAxisPpem:  at this many pixels per em and more, cast rays along
+ *                  one axis only, the one whose band has fewer curves.
+ *                  About halves the cost of large glyphs, but edges along
+ *                  the rays antialias poorly.  Pass it per glyph from the
+ *                  vertex data to pick glyphs for it.  Blobs encoded with
+ *                  GLYPHY_FLAG_SINGLE_AXIS always use their one axis.
  */
-float glyphy_render (vec2 renderCoord, uint glyphLoc_)
+float glyphy_render (vec2 renderCoord, uint glyphLoc_,
+		     vec4 ext, vec4 bandTransform, ivec4 header,
+		     float singleAxisPpem)
 {
   vec2 emsPerPixel = fwidth (renderCoord);
   vec2 pixelsPerEm = 1.0 / emsPerPixel;
 
   int glyphLoc = int (glyphLoc_);
 
-  /* Read blob header */
-  ivec4 header0 = texelFetch (u_atlas, glyphLoc);
-  ivec4 header1 = texelFetch (u_atlas, glyphLoc + 1);
-  vec4 ext = vec4 (header0) * GLYPHY_INV_UNITS; /* min_x, min_y, max_x, max_y */
-  int numHBands = header1.r;
-  int numVBands = header1.g;
+  int numHBands = header.r;
+  int numVBands = header.g;
+  bool bounded = (header.b & GLYPHY_BLOB_FLAG_BOUNDED_INDICES) != 0;
+  bool cubic = (header.b & GLYPHY_BLOB_FLAG_CUBICS) != 0;
+  bool singleAxis = numHBands == 0 || numVBands == 0 ||
+		    min (pixelsPerEm.x, pixelsPerEm.y) >= singleAxisPpem;
 
-  /* Compute band transform from extents */
-  vec2 extSize = ext.zw - ext.xy; /* (width, height) */
-  vec2 bandScale = vec2 (float (numVBands), float (numHBands)) / max (extSize, vec2 (1.0 / 65536.0));
-  vec2 bandOffset = -ext.xy * bandScale;
+  if ((header.b & GLYPHY_BLOB_FLAG_CELL_GRID) != 0)
+  {
+    float cellCoverage = _glyphy_cell_coverage (glyphLoc + header.a, ext,
+						renderCoord, pixelsPerEm);
+    if (cellCoverage >= 0.0)
+      return cellCoverage;
+  }
 
-  ivec2 bandIndex = clamp (ivec2 (renderCoord * bandScale + bandOffset),
-			   ivec2 (0, 0),
-			   ivec2 (numVBands - 1, numHBands - 1));
+  if ((header.b & GLYPHY_BLOB_FLAG_SUB_BANDS) != 0)
+    return _glyphy_render_sub_bands (glyphLoc, ext, bandTransform,
+				     numHBands, numVBands, cubic, singleAxis,
+				     renderCoord, pixelsPerEm);
 
   /* Skip past header (2 texels) */
   int bandBase = glyphLoc + 2;
 
+  ivec2 bandIndex;
+  if ((header.b & GLYPHY_BLOB_FLAG_BALANCED_BANDS) != 0)
+  {
+    /* Edge tables follow the band headers, h-bands first. */
+    int edgeBase = bandBase + numHBands + numVBands;
+    bandIndex = ivec2 (_glyphy_find_band (edgeBase + ((numHBands + 2) >> 2), numVBands, renderCoord.x),
+		       _glyphy_find_band (edgeBase, numHBands, renderCoord.y));
+  }
+  else
+    bandIndex = clamp (ivec2 (renderCoord * bandTransform.xy + bandTransform.zw),
+		       ivec2 (0, 0),
+		       max (ivec2 (numVBands - 1, numHBands - 1), ivec2 (0, 0)));
+
+  ivec4 hbandData = numHBands != 0 ? texelFetch (u_atlas, bandBase + bandIndex.y) : ivec4 (0);
+  ivec4 vbandData = numVBands != 0 ? texelFetch (u_atlas, bandBase + numHBands + bandIndex.x) : ivec4 (0);
+
+  /* For one axis, the one with fewer curves to test. */
+  bool doH = numHBands != 0 && (!singleAxis || numVBands == 0 || hbandData.r <= vbandData.r);
+  bool doV = numVBands != 0 && (!singleAxis || !doH);
+
   float xcov = 0.0;
   float xwgt = 0.0;
 
-  ivec4 hbandData = texelFetch (u_atlas, bandBase + bandIndex.y);
-  int hCurveCount = hbandData.r;
+  int hCurveCount = doH ? hbandData.r : 0;
   /* Symmetric: choose rightward (desc) or leftward (asc) sort */
   float hSplit = float (hbandData.a) * GLYPHY_INV_UNITS;
   bool hLeftRay = (renderCoord.x < hSplit);
   int hDataOffset = hLeftRay ? hbandData.b : hbandData.g;
 
-  for (int ci = 0; ci < hCurveCount; ci++)
+  if (bounded)
   {
-    int curveOffset = texelFetch (u_atlas, glyphLoc + hDataOffset + ci).r;
-
-    ivec4 raw12 = texelFetch (u_atlas, glyphLoc + curveOffset);
-    ivec4 raw3 = texelFetch (u_atlas, glyphLoc + curveOffset + 1);
+    /* One curve per index texel, with its bounds. */
+    for (int ci = 0; ci < hCurveCount; ci++)
+    {
+      ivec4 entry = texelFetch (u_atlas, glyphLoc + hDataOffset + ci);
+      vec3 bounds = vec3 (entry.gba) * GLYPHY_INV_UNITS - renderCoord.xyy;
 
-    vec4 p12 = vec4 (raw12) * GLYPHY_INV_UNITS - vec4 (renderCoord, renderCoord);
-    vec2 p3 = vec2 (raw3.rg) * GLYPHY_INV_UNITS - renderCoord;
+      if (_glyphy_entry_past (bounds.x, pixelsPerEm.x, hLeftRay)) break;
+      /* Entirely above or below the ray: no roots. */
+      if (bounds.y > 0.0 || bounds.z < 0.0) continue;
 
-    if (hLeftRay) {
-      if (min (min (p12.x, p12.z), p3.x) * pixelsPerEm.x > 0.5) break;
-    } else {
-      if (max (max (p12.x, p12.z), p3.x) * pixelsPerEm.x < -0.5) break;
+      _glyphy_horiz_curve (glyphLoc + entry.r, renderCoord, pixelsPerEm.x,
+			   hLeftRay, cubic, xcov, xwgt);
     }
-
-    uint code = _glyphy_calc_root_code (p12.y, p12.w, p3.y);
-    if (code != 0U)
+  }
+  else
+  {
+    /* Curve indices are packed four per texel. */
+    ivec4 hIndices = ivec4 (0);
+    for (int ci = 0; ci < hCurveCount; ci++)
     {
-      vec2 r = _glyphy_solve_horiz_poly (p12, p3) * pixelsPerEm.x;
-      /* For leftward ray: saturate(0.5 - r) counts coverage from the left */
-      vec2 cov = hLeftRay ? clamp (vec2 (0.5) - r, 0.0, 1.0)
-			  : clamp (r + vec2 (0.5), 0.0, 1.0);
-
-      if ((code & 1U) != 0U)
-      {
-	xcov += cov.x;
-	xwgt = max (xwgt, clamp (1.0 - abs (r.x) * 2.0, 0.0, 1.0));
-      }
-
-      if (code > 1U)
-      {
-	xcov -= cov.y;
-	xwgt = max (xwgt, clamp (1.0 - abs (r.y) * 2.0, 0.0, 1.0));
-      }
+      if ((ci & 3) == 0)
+	hIndices = texelFetch (u_atlas, glyphLoc + hDataOffset + (ci >> 2));
+
+      if (!_glyphy_horiz_curve (glyphLoc + hIndices[ci & 3], renderCoord,
+				pixelsPerEm.x, hLeftRay, cubic, xcov, xwgt)) break;
     }
   }
 
   float ycov = 0.0;
   float ywgt = 0.0;
 
-  ivec4 vbandData = texelFetch (u_atlas, bandBase + numHBands + bandIndex.x);
-  int vCurveCount = vbandData.r;
+  int vCurveCount = doV ? vbandData.r : 0;
   float vSplit = float (vbandData.a) * GLYPHY_INV_UNITS;
   bool vLeftRay = (renderCoord.y < vSplit);
   int vDataOffset = vLeftRay ? vbandData.b : vbandData.g;
 
-  for (int ci = 0; ci < vCurveCount; ci++)
+  if (bounded)
   {
-    int curveOffset = texelFetch (u_atlas, glyphLoc + vDataOffset + ci).r;
-
-    ivec4 raw12 = texelFetch (u_atlas, glyphLoc + curveOffset);
-    ivec4 raw3 = texelFetch (u_atlas, glyphLoc + curveOffset + 1);
+    for (int ci = 0; ci < vCurveCount; ci++)
+    {
+      ivec4 entry = texelFetch (u_atlas, glyphLoc + vDataOffset + ci);
+      vec3 bounds = vec3 (entry.gba) * GLYPHY_INV_UNITS - renderCoord.yxx;
 
-    vec4 p12 = vec4 (raw12) * GLYPHY_INV_UNITS - vec4 (renderCoord, renderCoord);
-    vec2 p3 = vec2 (raw3.rg) * GLYPHY_INV_UNITS - renderCoord;
+      if (_glyphy_entry_past (bounds.x, pixelsPerEm.y, vLeftRay)) break;
+      if (bounds.y > 0.0 || bounds.z < 0.0) continue;
 
-    if (vLeftRay) {
-      if (min (min (p12.y, p12.w), p3.y) * pixelsPerEm.y > 0.5) break;
-    } else {
-      if (max (max (p12.y, p12.w), p3.y) * pixelsPerEm.y < -0.5) break;
+      _glyphy_vert_curve (glyphLoc + entry.r, renderCoord, pixelsPerEm.y,
+			  vLeftRay, cubic, ycov, ywgt);
     }
-
-    uint code = _glyphy_calc_root_code (p12.x, p12.z, p3.x);
-    if (code != 0U)
+  }
+  else
+  {
+    ivec4 vIndices = ivec4 (0);
+    for (int ci = 0; ci < vCurveCount; ci++)
     {
-      vec2 r = _glyphy_solve_vert_poly (p12, p3) * pixelsPerEm.y;
-      vec2 cov = vLeftRay ? clamp (vec2 (0.5) - r, 0.0, 1.0)
-			  : clamp (r + vec2 (0.5), 0.0, 1.0);
-
-      if ((code & 1U) != 0U)
-      {
-	ycov -= cov.x;
-	ywgt = max (ywgt, clamp (1.0 - abs (r.x) * 2.0, 0.0, 1.0));
-      }
-
-      if (code > 1U)
-      {
-	ycov += cov.y;
-	ywgt = max (ywgt, clamp (1.0 - abs (r.y) * 2.0, 0.0, 1.0));
-      }
+      if ((ci & 3) == 0)
+	vIndices = texelFetch (u_atlas, glyphLoc + vDataOffset + (ci >> 2));
+
+      if (!_glyphy_vert_curve (glyphLoc + vIndices[ci & 3], renderCoord,
+			       pixelsPerEm.y, vLeftRay, cubic, ycov, ywgt)) break;
     }
   }
 
+  if (!doV)
+    return _glyphy_calc_single_coverage (xcov);
+  if (!doH)
+    return _glyphy_calc_single_coverage (ycov);
   return _glyphy_calc_coverage (xcov, ycov, xwgt, ywgt);
 }
+
+float glyphy_render (vec2 renderCoord, uint glyphLoc,
+		     vec4 ext, vec4 bandTransform, ivec4 header)
+{
+  /* Both axes at any size that fits in a float. */
+  return glyphy_render (renderCoord, glyphLoc, ext, bandTransform, header, 3.0e38);
+}
+
+/* Render a glyph and return its coverage in [0, 1], decoding its blob
+ * header here.  Arguments as above. */
+float glyphy_render (vec2 renderCoord, uint glyphLoc, float singleAxisPpem)
+{
+  /* Same as glyphy_decode_header() in glyphy-vertex.glsl */
+  int loc = int (glyphLoc);
+  vec4 ext = vec4 (texelFetch (u_atlas, loc)) * GLYPHY_INV_UNITS; /* min_x, min_y, max_x, max_y */
+  ivec4 header = texelFetch (u_atlas, loc + 1);
+
+  vec2 extSize = max (ext.zw - ext.xy, vec2 (GLYPHY_INV_UNITS));
+  vec2 bandScale = vec2 (float (header.g), float (header.r)) / extSize;
+  vec4 bandTransform = vec4 (bandScale, -ext.xy * bandScale);
+
+  return glyphy_render (renderCoord, glyphLoc, ext, bandTransform, header, singleAxisPpem);
+}
+
+float glyphy_render (vec2 renderCoord, uint glyphLoc)
+{
+  /* Both axes at any size that fits in a float. */
+  return glyphy_render (renderCoord, glyphLoc, 3.0e38);
+}
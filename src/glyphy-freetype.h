@@ -17,6 +17,7 @@ extern "C" {
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #include FT_OUTLINE_H
+#include <stdlib.h>
 
 
 
@@ -86,6 +87,49 @@ glyphy_freetype(outline_decompose) (const FT_Outline              *outline,
   return FT_Outline_Decompose ((FT_Outline *) outline, &outline_funcs, acc);
 }
 
+/* Like outline_decompose, but converts the whole outline at once and
+ * hands it to glyphy_append_outline(), skipping the per-segment
+ * callbacks. */
+static FT_Error
+glyphy_freetype(outline_append) (const FT_Outline *outline,
+                                 glyphy_t         *acc)
+{
+  glyphy_point_t stack_points[256];
+  unsigned int stack_ends[32];
+  glyphy_point_t *points = stack_points;
+  unsigned int *ends = stack_ends;
+  unsigned int num_points = outline->n_points > 0 ? (unsigned int) outline->n_points : 0;
+  unsigned int num_contours = outline->n_contours > 0 ? (unsigned int) outline->n_contours : 0;
+  unsigned int i;
+
+  if (num_points > sizeof (stack_points) / sizeof (stack_points[0]))
+    points = (glyphy_point_t *) malloc (num_points * sizeof (glyphy_point_t));
+  if (num_contours > sizeof (stack_ends) / sizeof (stack_ends[0]))
+    ends = (unsigned int *) malloc (num_contours * sizeof (unsigned int));
+
+  if (points && ends) {
+    for (i = 0; i < num_points; i++) {
+      points[i].x = (double) outline->points[i].x;
+      points[i].y = (double) outline->points[i].y;
+    }
+    for (i = 0; i < num_contours; i++)
+      ends[i] = (unsigned short) outline->contours[i];
+
+    glyphy_append_outline (acc, points,
+                           (const unsigned char *) outline->tags, num_points,
+                           ends, num_contours);
+  }
+
+  if (points != stack_points)
+    free (points);
+  if (ends != stack_ends)
+    free (ends);
+
+  if (!points || !ends)
+    return FT_Err_Out_Of_Memory;
+  return glyphy_successful (acc) ? FT_Err_Ok : FT_Err_Invalid_Outline;
+}
+
 #ifdef __cplusplus
 }
 #endif
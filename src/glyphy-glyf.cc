@@ -0,0 +1,358 @@
+/*
+ * Copyright 2026 Behdad Esfahbod. All Rights Reserved.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "glyphy.h"
+#include "glyphy.hh"
+
+#include <cstddef>
+#include <vector>
+
+
+/*
+ * TrueType 'glyf' outlines, read straight from the font data.
+ *
+ * Simple glyphs are decoded into g->glyf and handed to
+ * glyphy_append_outline() one glyph at a time; composite glyphs append
+ * each of their components in turn, transformed.  Anything unusual
+ * makes us bail out, so that the caller can fall back to a full
+ * outline implementation such as HarfBuzz's.
+ */
+
+
+/* Composite nesting we follow; HarfBuzz and FreeType stop deeper. */
+#define GLYPHY_GLYF_MAX_NESTING 16
+/* Components we follow per glyph, so that nested composites cannot
+ * blow up. */
+#define GLYPHY_GLYF_MAX_COMPONENTS 1024
+
+/* Simple glyph point flags */
+enum {
+  GLYF_ON_CURVE       = 0x01,
+  GLYF_X_SHORT        = 0x02,
+  GLYF_Y_SHORT        = 0x04,
+  GLYF_REPEAT         = 0x08,
+  GLYF_X_SAME_OR_POS  = 0x10,
+  GLYF_Y_SAME_OR_POS  = 0x20,
+  GLYF_CUBIC          = 0x80,
+};
+
+/* Composite glyph component flags */
+enum {
+  GLYF_ARG_1_AND_2_ARE_WORDS     = 0x0001,
+  GLYF_ARGS_ARE_XY_VALUES        = 0x0002,
+  GLYF_WE_HAVE_A_SCALE           = 0x0008,
+  GLYF_MORE_COMPONENTS           = 0x0020,
+  GLYF_WE_HAVE_AN_X_AND_Y_SCALE  = 0x0040,
+  GLYF_WE_HAVE_A_TWO_BY_TWO      = 0x0080,
+  GLYF_SCALED_COMPONENT_OFFSET   = 0x0800,
+  GLYF_UNSCALED_COMPONENT_OFFSET = 0x1000,
+};
+
+/* x' = xx * x + yx * y + dx, y' = xy * x + yy * y + dy */
+struct glyf_transform_t {
+  double xx, xy, yx, yy;
+  double dx, dy;
+};
+
+static inline unsigned int
+read_u16 (const unsigned char *p)
+{
+  return (p[0] << 8) | p[1];
+}
+
+static inline int
+read_i16 (const unsigned char *p)
+{
+  return (int16_t) read_u16 (p);
+}
+
+static inline unsigned int
+read_u32 (const unsigned char *p)
+{
+  return ((unsigned int) p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static inline double
+read_f2dot14 (const unsigned char *p)
+{
+  return read_i16 (p) / 16384.;
+}
+
+/* Sets *data and *len to the glyph's record; empty glyphs have len 0. */
+static bool
+find_glyph (const glyphy_glyf_t   *tables,
+            unsigned int           glyph,
+            const unsigned char  **data,
+            unsigned int          *len)
+{
+  unsigned int start, end;
+
+  if (tables->long_loca) {
+    if (tables->loca_len < 4 || glyph >= tables->loca_len / 4 - 1)
+      return false;
+    start = read_u32 (tables->loca + 4 * glyph);
+    end = read_u32 (tables->loca + 4 * glyph + 4);
+  } else {
+    if (tables->loca_len < 2 || glyph >= tables->loca_len / 2 - 1)
+      return false;
+    start = 2 * read_u16 (tables->loca + 2 * glyph);
+    end = 2 * read_u16 (tables->loca + 2 * glyph + 2);
+  }
+
+  if (start > end || end > tables->glyf_len)
+    return false;
+
+  *data = tables->glyf + start;
+  *len = end - start;
+  return true;
+}
+
+/* Left side bearing of glyph, from hmtx. */
+static bool
+get_lsb (const glyphy_glyf_t *tables,
+         unsigned int         glyph,
+         int                 *lsb)
+{
+  unsigned int offset = glyph < tables->num_h_metrics
+                      ? 4 * glyph + 2
+                      : 4 * tables->num_h_metrics + 2 * (glyph - tables->num_h_metrics);
+  if (!tables->num_h_metrics || offset + 2 > tables->hmtx_len)
+    return false;
+  *lsb = read_i16 (tables->hmtx + offset);
+  return true;
+}
+
+/* Decodes a simple glyph with num_contours contours into g->glyf and
+ * appends it. */
+static bool
+append_simple_glyph (glyphy_t               *g,
+                     const unsigned char    *data,
+                     const unsigned char    *end,
+                     unsigned int            num_contours,
+                     const glyf_transform_t &transform)
+{
+  glyphy_glyf_scratch_t &scratch = g->glyf;
+  const unsigned char *p = data + 10;
+
+  if (end - p < 2 * (ptrdiff_t) num_contours + 2)
+    return false;
+
+  std::vector<unsigned int> &contour_ends = scratch.contour_ends;
+  contour_ends.resize (num_contours);
+  for (unsigned int i = 0; i < num_contours; i++, p += 2) {
+    contour_ends[i] = read_u16 (p);
+    if (i && contour_ends[i] <= contour_ends[i - 1])
+      return false;
+  }
+  unsigned int num_points = num_contours ? contour_ends[num_contours - 1] + 1 : 0;
+
+  /* Skip hinting instructions. */
+  unsigned int instructions_len = read_u16 (p);
+  p += 2;
+  if (end - p < (ptrdiff_t) instructions_len)
+    return false;
+  p += instructions_len;
+
+  /* Flags; keep them in tags for now. */
+  std::vector<unsigned char> &tags = scratch.tags;
+  tags.resize (num_points);
+  for (unsigned int i = 0; i < num_points;) {
+    if (p == end)
+      return false;
+    unsigned char flag = *p++;
+    unsigned int repeat = 1;
+    if (flag & GLYF_REPEAT) {
+      if (p == end)
+        return false;
+      repeat += *p++;
+    }
+    if (repeat > num_points - i)
+      return false;
+    for (; repeat; repeat--)
+      tags[i++] = flag;
+  }
+
+  /* Delta-encoded x, then y coordinates. */
+  std::vector<glyphy_point_t> &points = scratch.points;
+  points.resize (num_points);
+  for (unsigned int axis = 0; axis < 2; axis++) {
+    unsigned char short_flag = axis ? GLYF_Y_SHORT : GLYF_X_SHORT;
+    unsigned char same_flag = axis ? GLYF_Y_SAME_OR_POS : GLYF_X_SAME_OR_POS;
+    int v = 0;
+    for (unsigned int i = 0; i < num_points; i++) {
+      unsigned char flag = tags[i];
+      if (flag & short_flag) {
+        if (p == end)
+          return false;
+        v += (flag & same_flag) ? *p : -*p;
+        p++;
+      } else if (!(flag & same_flag)) {
+        if (end - p < 2)
+          return false;
+        v += read_i16 (p);
+        p += 2;
+      }
+      (axis ? points[i].y : points[i].x) = v;
+    }
+  }
+
+  for (unsigned int i = 0; i < num_points; i++) {
+    unsigned char flag = tags[i];
+    tags[i] = (flag & GLYF_ON_CURVE) ? GLYPHY_POINT_TAG_ON :
+              (flag & GLYF_CUBIC) ? GLYPHY_POINT_TAG_CUBIC :
+              GLYPHY_POINT_TAG_CONIC;
+
+    glyphy_point_t pt = points[i];
+    points[i].x = transform.xx * pt.x + transform.yx * pt.y + transform.dx;
+    points[i].y = transform.xy * pt.x + transform.yy * pt.y + transform.dy;
+  }
+
+  glyphy_append_outline (g, points.data (), tags.data (), num_points,
+                         contour_ends.data (), num_contours);
+  return glyphy_successful (g);
+}
+
+static bool
+append_glyph (glyphy_t               *g,
+              const glyphy_glyf_t    *tables,
+              unsigned int            glyph,
+              const glyf_transform_t &transform,
+              unsigned int            depth,
+              unsigned int           *num_components)
+{
+  const unsigned char *data;
+  unsigned int len;
+
+  if (depth > GLYPHY_GLYF_MAX_NESTING || !find_glyph (tables, glyph, &data, &len))
+    return false;
+  if (!len)
+    return true;
+  if (len < 10)
+    return false;
+
+  const unsigned char *end = data + len;
+  int num_contours = read_i16 (data);
+  if (num_contours >= 0)
+    return append_simple_glyph (g, data, end, num_contours, transform);
+
+  const unsigned char *p = data + 10;
+  unsigned int flags;
+  do {
+    if (end - p < 4 || ++*num_components > GLYPHY_GLYF_MAX_COMPONENTS)
+      return false;
+    flags = read_u16 (p);
+    unsigned int component = read_u16 (p + 2);
+    p += 4;
+
+    /* Components attached by point numbers would need the points of
+     * everything drawn so far. */
+    if (!(flags & GLYF_ARGS_ARE_XY_VALUES))
+      return false;
+
+    double dx, dy;
+    if (flags & GLYF_ARG_1_AND_2_ARE_WORDS) {
+      if (end - p < 4)
+        return false;
+      dx = read_i16 (p);
+      dy = read_i16 (p + 2);
+      p += 4;
+    } else {
+      if (end - p < 2)
+        return false;
+      dx = (int8_t) p[0];
+      dy = (int8_t) p[1];
+      p += 2;
+    }
+
+    glyf_transform_t t = {1, 0, 0, 1, 0, 0};
+    if (flags & GLYF_WE_HAVE_A_SCALE) {
+      if (end - p < 2)
+        return false;
+      t.xx = t.yy = read_f2dot14 (p);
+      p += 2;
+    } else if (flags & GLYF_WE_HAVE_AN_X_AND_Y_SCALE) {
+      if (end - p < 4)
+        return false;
+      t.xx = read_f2dot14 (p);
+      t.yy = read_f2dot14 (p + 2);
+      p += 4;
+    } else if (flags & GLYF_WE_HAVE_A_TWO_BY_TWO) {
+      if (end - p < 8)
+        return false;
+      t.xx = read_f2dot14 (p);
+      t.xy = read_f2dot14 (p + 2);
+      t.yx = read_f2dot14 (p + 4);
+      t.yy = read_f2dot14 (p + 6);
+      p += 8;
+    }
+
+    /* The offset is in the parent's space, unless it is to be scaled
+     * along with the component. */
+    if ((flags & (GLYF_SCALED_COMPONENT_OFFSET | GLYF_UNSCALED_COMPONENT_OFFSET)) ==
+        GLYF_SCALED_COMPONENT_OFFSET) {
+      t.dx = t.xx * dx + t.yx * dy;
+      t.dy = t.xy * dx + t.yy * dy;
+    } else {
+      t.dx = dx;
+      t.dy = dy;
+    }
+
+    /* Component space to glyph space: transform, then parent's. */
+    glyf_transform_t c = {
+      transform.xx * t.xx + transform.yx * t.xy,
+      transform.xy * t.xx + transform.yy * t.xy,
+      transform.xx * t.yx + transform.yx * t.yy,
+      transform.xy * t.yx + transform.yy * t.yy,
+      transform.xx * t.dx + transform.yx * t.dy + transform.dx,
+      transform.xy * t.dx + transform.yy * t.dy + transform.dy,
+    };
+    if (!append_glyph (g, tables, component, c, depth + 1, num_components))
+      return false;
+  } while (flags & GLYF_MORE_COMPONENTS);
+
+  return true;
+}
+
+glyphy_bool_t
+glyphy_glyf_append_glyph (glyphy_t            *g,
+                          const glyphy_glyf_t *tables,
+                          unsigned int         glyph)
+{
+  if (!g->success)
+    return false;
+
+  /* Enough to undo a partly appended glyph. */
+  unsigned int num_curves = g->curves.size ();
+  glyphy_point_t start_point = g->start_point;
+  glyphy_point_t current_point = g->current_point;
+  bool need_moveto = g->need_moveto;
+
+  /* Like FreeType and HarfBuzz, move the glyph so that its left side
+   * bearing is the one in hmtx. */
+  glyf_transform_t transform = {1, 0, 0, 1, 0, 0};
+  const unsigned char *data;
+  unsigned int len;
+  int lsb;
+  if (find_glyph (tables, glyph, &data, &len) && len >= 10 &&
+      get_lsb (tables, glyph, &lsb))
+    transform.dx = lsb - read_i16 (data + 2);
+
+  unsigned int num_components = 0;
+  if (append_glyph (g, tables, glyph, transform, 0, &num_components))
+    return true;
+
+  g->curves.truncate (num_curves);
+  g->num_curves = num_curves;
+  g->scratch.layout_valid = false;
+  g->start_point = start_point;
+  g->current_point = current_point;
+  g->need_moveto = need_moveto;
+  g->success = true;
+  return false;
+}
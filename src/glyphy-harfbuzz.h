@@ -13,6 +13,7 @@ extern "C" {
 
 
 #include <hb.h>
+#include <stdlib.h>
 
 
 
@@ -86,6 +87,8 @@ glyphy_harfbuzz(close_path) (hb_draw_funcs_t *dfuncs,
   glyphy_close_path (acc);
 }
 
+/* Not thread-safe the first time; the glyf reader and the parallel
+ * encoder call it before any worker threads start. */
 static hb_draw_funcs_t *
 glyphy_harfbuzz(get_draw_funcs) (void)
 {
@@ -113,6 +116,183 @@ glyphy_harfbuzz(font_get_glyph_shape) (hb_font_t *font,
   hb_font_draw_glyph (font, glyph, glyphy_harfbuzz(get_draw_funcs) (), acc);
 }
 
+static glyphy_bool_t
+glyphy_harfbuzz(get_glyph_shape) (glyphy_t    *acc,
+                                  unsigned int glyph,
+                                  void        *font)
+{
+  glyphy_harfbuzz(font_get_glyph_shape) ((hb_font_t *) font, glyph, acc);
+  return glyphy_successful (acc);
+}
+
+/* Reads glyf outlines of a font directly with glyphy_glyf_append_glyph(),
+ * falling back to hb_font_draw_glyph() for glyphs it does not handle and
+ * for fonts where HarfBuzz would draw something else: other outline
+ * formats, variations, synthetic slant or bold, or a scale other than
+ * the units per em. */
+typedef struct {
+  hb_font_t     *font;
+  hb_blob_t     *glyf_blob;
+  hb_blob_t     *loca_blob;
+  hb_blob_t     *hmtx_blob;
+  glyphy_glyf_t  tables;
+  glyphy_bool_t  direct;
+} glyphy_harfbuzz(glyf_reader_t);
+
+static glyphy_harfbuzz(glyf_reader_t) *
+glyphy_harfbuzz(glyf_reader_create) (hb_font_t *font)
+{
+  glyphy_harfbuzz(glyf_reader_t) *reader;
+  hb_face_t *face = hb_font_get_face (font);
+  hb_blob_t *head_blob, *hhea_blob;
+  const unsigned char *head, *hhea;
+  unsigned int head_len, hhea_len, coords_len, upem;
+  int x_scale, y_scale;
+
+  reader = (glyphy_harfbuzz(glyf_reader_t) *) calloc (1, sizeof (*reader));
+  if (!reader)
+    return NULL;
+
+  /* For the fallback, which may run on several threads at once. */
+  glyphy_harfbuzz(get_draw_funcs) ();
+
+  reader->font = hb_font_reference (font);
+  reader->glyf_blob = hb_face_reference_table (face, HB_TAG ('g','l','y','f'));
+  reader->loca_blob = hb_face_reference_table (face, HB_TAG ('l','o','c','a'));
+  reader->tables.glyf = (const unsigned char *) hb_blob_get_data (reader->glyf_blob, &reader->tables.glyf_len);
+  reader->tables.loca = (const unsigned char *) hb_blob_get_data (reader->loca_blob, &reader->tables.loca_len);
+  reader->hmtx_blob = hb_face_reference_table (face, HB_TAG ('h','m','t','x'));
+  reader->tables.hmtx = (const unsigned char *) hb_blob_get_data (reader->hmtx_blob, &reader->tables.hmtx_len);
+
+  head_blob = hb_face_reference_table (face, HB_TAG ('h','e','a','d'));
+  head = (const unsigned char *) hb_blob_get_data (head_blob, &head_len);
+  if (head_len >= 54)
+    reader->tables.long_loca = ((head[50] << 8) | head[51]) != 0; /* indexToLocFormat */
+  hb_blob_destroy (head_blob);
+
+  hhea_blob = hb_face_reference_table (face, HB_TAG ('h','h','e','a'));
+  hhea = (const unsigned char *) hb_blob_get_data (hhea_blob, &hhea_len);
+  if (hhea_len >= 36)
+    reader->tables.num_h_metrics = (hhea[34] << 8) | hhea[35];
+  hb_blob_destroy (hhea_blob);
+
+  upem = hb_face_get_upem (face);
+  hb_font_get_scale (font, &x_scale, &y_scale);
+  hb_font_get_var_coords_normalized (font, &coords_len);
+
+  reader->direct = reader->tables.glyf_len && reader->tables.loca_len &&
+                   head_len >= 54 &&
+                   x_scale == (int) upem && y_scale == (int) upem &&
+                   !coords_len &&
+                   hb_font_get_synthetic_slant (font) == 0.f;
+#if HB_VERSION_ATLEAST(7,0,0)
+  {
+    float x_strength, y_strength;
+    hb_bool_t in_place;
+    hb_font_get_synthetic_bold (font, &x_strength, &y_strength, &in_place);
+    if (x_strength != 0.f || y_strength != 0.f)
+      reader->direct = 0;
+  }
+#endif
+
+  return reader;
+}
+
+static void
+glyphy_harfbuzz(glyf_reader_destroy) (glyphy_harfbuzz(glyf_reader_t) *reader)
+{
+  if (!reader)
+    return;
+  hb_blob_destroy (reader->glyf_blob);
+  hb_blob_destroy (reader->loca_blob);
+  hb_blob_destroy (reader->hmtx_blob);
+  hb_font_destroy (reader->font);
+  free (reader);
+}
+
+static void
+glyphy_harfbuzz(glyf_reader_get_glyph_shape) (glyphy_harfbuzz(glyf_reader_t) *reader,
+                                              hb_codepoint_t                   glyph,
+                                              glyphy_t                        *acc)
+{
+  if (reader->direct && glyphy_glyf_append_glyph (acc, &reader->tables, glyph))
+    return;
+  glyphy_harfbuzz(font_get_glyph_shape) (reader->font, glyph, acc);
+}
+
+/* glyphy_get_glyph_shape_func_t taking a glyf reader as user_data. */
+static glyphy_bool_t
+glyphy_harfbuzz(glyf_get_glyph_shape) (glyphy_t    *acc,
+                                       unsigned int glyph,
+                                       void        *reader)
+{
+  glyphy_harfbuzz(glyf_reader_get_glyph_shape) ((glyphy_harfbuzz(glyf_reader_t) *) reader,
+                                                glyph, acc);
+  return glyphy_successful (acc);
+}
+
+/* Encodes glyphs of font back to back into buffer; see glyphy_encode_batch(). */
+static unsigned int
+glyphy_harfbuzz(font_encode_glyphs) (hb_font_t            *font,
+                                     glyphy_t             *acc,
+                                     const hb_codepoint_t *glyphs,
+                                     unsigned int          num_glyphs,
+                                     glyphy_texel_t       *buffer,
+                                     unsigned int          buffer_size,
+                                     unsigned int         *output_len,
+                                     glyphy_glyph_blob_t  *blobs)
+{
+  return glyphy_encode_batch (acc,
+                              glyphy_harfbuzz(get_glyph_shape), font,
+                              (const unsigned int *) glyphs, num_glyphs,
+                              buffer, buffer_size,
+                              output_len,
+                              blobs);
+}
+
+/* Encodes glyphs of font on num_threads threads, each drawing from its
+ * own sub-font of font; see glyphy_encode_parallel(). */
+static glyphy_bool_t
+glyphy_harfbuzz(font_encode_glyphs_parallel) (hb_font_t            *font,
+                                              glyphy_t             *acc,
+                                              unsigned int          num_threads,
+                                              const hb_codepoint_t *glyphs,
+                                              unsigned int          num_glyphs,
+                                              glyphy_texel_t       *buffer,
+                                              unsigned int          buffer_size,
+                                              unsigned int         *output_len,
+                                              glyphy_glyph_blob_t  *blobs)
+{
+  glyphy_bool_t ret;
+  unsigned int i;
+  void **fonts;
+
+  if (!num_threads)
+    num_threads = 1;
+
+  fonts = (void **) malloc (num_threads * sizeof (void *));
+  if (!fonts)
+    return 0;
+  for (i = 0; i < num_threads; i++)
+    fonts[i] = hb_font_create_sub_font (font);
+
+  /* Create the draw funcs before the threads that share them. */
+  glyphy_harfbuzz(get_draw_funcs) ();
+
+  ret = glyphy_encode_parallel (acc, num_threads,
+                                glyphy_harfbuzz(get_glyph_shape), fonts,
+                                (const unsigned int *) glyphs, num_glyphs,
+                                buffer, buffer_size,
+                                output_len,
+                                blobs);
+
+  for (i = 0; i < num_threads; i++)
+    hb_font_destroy ((hb_font_t *) fonts[i]);
+  free (fonts);
+
+  return ret;
+}
+
 #ifdef __cplusplus
 }
 #endif
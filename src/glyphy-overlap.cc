@@ -0,0 +1,387 @@
+/*
+ * Copyright 2026 Behdad Esfahbod. All Rights Reserved.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "glyphy.h"
+#include "glyphy.hh"
+
+#include <algorithm>
+#include <cmath>
+
+
+/*
+ * Overlap removal (GLYPHY_FLAG_REMOVE_OVERLAPS).
+ *
+ * Composite glyphs and variable-font outlines often draw overlapping
+ * contours.  Curves inside the filled area do not change coverage, but
+ * still land in band lists and cost fragments a curve test each.
+ *
+ * We split the curves where they cross each other, and take the winding
+ * number just to either side of each piece.  Pieces with filled space
+ * on both sides are dropped; the rest are the boundary of the union,
+ * which fills the same area under the shader's nonzero rule.  Pieces
+ * stay in their contours' order, so endpoint sharing still applies.
+ *
+ * Intersections are found by subdividing both curves until their
+ * control boxes are tiny.  Curves that run along each other, instead
+ * of crossing, do not settle that way; then, or if the kept pieces do
+ * not join up into closed contours, the curves are left as they are.
+ */
+
+/* Subdivision stops at this fraction of the outline's size. */
+#define GLYPHY_OVERLAP_TOLERANCE (1. / (1 << 24))
+
+/* Limits on subdividing one pair of curves. */
+#define GLYPHY_OVERLAP_MAX_DEPTH 64
+#define GLYPHY_OVERLAP_MAX_STEPS (1 << 14)
+
+/* Winding is sampled this fraction of the outline's size away from a
+ * piece, or a quarter of the piece's length if that is less. */
+#define GLYPHY_OVERLAP_SAMPLE_OFFSET (1. / (1 << 20))
+
+
+static inline double
+distance (const glyphy_point_t &a, const glyphy_point_t &b)
+{
+  return hypot (a.x - b.x, a.y - b.y);
+}
+
+static void
+control_box (const glyphy_point_t *c, unsigned int order, double box[4])
+{
+  box[0] = box[2] = c[0].x;
+  box[1] = box[3] = c[0].y;
+  for (unsigned int i = 1; i < order; i++) {
+    box[0] = std::min (box[0], c[i].x);
+    box[1] = std::min (box[1], c[i].y);
+    box[2] = std::max (box[2], c[i].x);
+    box[3] = std::max (box[3], c[i].y);
+  }
+}
+
+static inline bool
+boxes_overlap (const double a[4], const double b[4])
+{
+  return a[0] <= b[2] && b[0] <= a[2] && a[1] <= b[3] && b[1] <= a[3];
+}
+
+
+/*
+ * Winding numbers
+ */
+
+/* Signed crossing of the rightward ray from p with the curve between
+ * t0 and t1, where it is monotonic in y.  Spans include their lower
+ * end only, so a ray through a vertex is counted once. */
+static int
+monotonic_crossing (const glyphy_point_t *c, unsigned int order,
+                    double t0, double t1, const glyphy_point_t &p)
+{
+  glyphy_point_t a = glyphy_bezier_eval (c, order, t0);
+  glyphy_point_t b = glyphy_bezier_eval (c, order, t1);
+  bool up = a.y < b.y;
+  if (up ? !(a.y <= p.y && p.y < b.y) : !(b.y <= p.y && p.y < a.y))
+    return 0;
+
+  double lo = t0, hi = t1;
+  while (hi - lo > 1e-15) {
+    double mid = .5 * (lo + hi);
+    if (mid <= lo || mid >= hi)
+      break;
+    if ((glyphy_bezier_eval (c, order, mid).y <= p.y) == up)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  if (glyphy_bezier_eval (c, order, .5 * (lo + hi)).x <= p.x)
+    return 0;
+  return up ? 1 : -1;
+}
+
+int
+glyphy_winding_number (const glyphy_point_t *points,
+                       const double         *boxes,
+                       unsigned int          num_curves,
+                       unsigned int          order,
+                       const glyphy_point_t &p)
+{
+  int w = 0;
+  for (unsigned int i = 0; i < num_curves; i++) {
+    const double *box = &boxes[4 * i];
+    if (p.y < box[1] || p.y > box[3] || p.x > box[2])
+      continue;
+
+    const glyphy_point_t *c = &points[4 * i];
+    double t[4] = {0};
+    unsigned int n = 1 + glyphy_bezier_turns (c, order, true, t + 1);
+    t[n] = 1;
+    for (unsigned int k = 0; k < n; k++)
+      w += monotonic_crossing (c, order, t[k], t[k + 1], p);
+  }
+  return w;
+}
+
+
+/*
+ * Intersections
+ */
+
+struct subdivision_t {
+  glyphy_point_t a[4], b[4];
+  double a0, a1, b0, b1;
+  unsigned int depth;
+};
+
+/* Append parameter pairs where curves a and b meet, as ta, tb, to hits.
+ * Returns false if subdivision does not settle. */
+static bool
+intersect_curves (const glyphy_point_t *a,
+                  const glyphy_point_t *b,
+                  unsigned int          order,
+                  double                tolerance,
+                  std::vector<double>  &hits)
+{
+  subdivision_t stack[GLYPHY_OVERLAP_MAX_DEPTH + 2];
+  unsigned int n = 0;
+  stack[n].a0 = stack[n].b0 = 0;
+  stack[n].a1 = stack[n].b1 = 1;
+  stack[n].depth = 0;
+  std::copy (a, a + order, stack[n].a);
+  std::copy (b, b + order, stack[n].b);
+  n++;
+
+  unsigned int steps = 0;
+  while (n) {
+    if (++steps > GLYPHY_OVERLAP_MAX_STEPS)
+      return false;
+
+    subdivision_t s = stack[--n];
+    double box_a[4], box_b[4];
+    control_box (s.a, order, box_a);
+    control_box (s.b, order, box_b);
+    if (!boxes_overlap (box_a, box_b))
+      continue;
+
+    double size_a = std::max (box_a[2] - box_a[0], box_a[3] - box_a[1]);
+    double size_b = std::max (box_b[2] - box_b[0], box_b[3] - box_b[1]);
+    if ((size_a <= tolerance && size_b <= tolerance) ||
+        s.depth == GLYPHY_OVERLAP_MAX_DEPTH) {
+      hits.push_back (.5 * (s.a0 + s.a1));
+      hits.push_back (.5 * (s.b0 + s.b1));
+      continue;
+    }
+
+    /* Push the right halves first, to search left to right. */
+    subdivision_t &right = stack[n++];
+    subdivision_t &left = stack[n++];
+    left = right = s;
+    left.depth = right.depth = s.depth + 1;
+    if (size_a >= size_b) {
+      glyphy_bezier_split (s.a, order, .5, left.a, right.a);
+      left.a1 = right.a0 = .5 * (s.a0 + s.a1);
+    } else {
+      glyphy_bezier_split (s.b, order, .5, left.b, right.b);
+      left.b1 = right.b0 = .5 * (s.b0 + s.b1);
+    }
+  }
+  return true;
+}
+
+/* Record where curves i and j cross, as splits of each at one common
+ * point.  Meetings at the end of either curve split only the other;
+ * meetings at the ends of both, such as the joints of a contour, split
+ * neither. */
+static bool
+find_splits (glyphy_overlap_scratch_t &scratch,
+             unsigned int              i,
+             unsigned int              j,
+             unsigned int              order,
+             double                    tolerance)
+{
+  const glyphy_point_t *a = &scratch.points[4 * i];
+  const glyphy_point_t *b = &scratch.points[4 * j];
+  std::vector<double> &hits = scratch.hits;
+  hits.clear ();
+  if (!intersect_curves (a, b, order, tolerance, hits))
+    return false;
+
+  /* Subdivision reports each crossing a few times over. */
+  double snap = 4 * tolerance;
+  unsigned int first = scratch.splits.size ();
+  for (unsigned int k = 0; k < hits.size (); k += 2) {
+    double ta = hits[k], tb = hits[k + 1];
+    glyphy_point_t p = glyphy_lerp (glyphy_bezier_eval (a, order, ta),
+                                    glyphy_bezier_eval (b, order, tb), .5);
+
+    bool seen = false;
+    for (unsigned int m = first; m < scratch.splits.size () && !seen; m++)
+      seen = distance (scratch.splits[m].p, p) <= snap;
+    if (seen)
+      continue;
+
+    const glyphy_point_t *a_end = distance (p, a[0]) <= snap ? &a[0] :
+                                  distance (p, a[order - 1]) <= snap ? &a[order - 1] : nullptr;
+    const glyphy_point_t *b_end = distance (p, b[0]) <= snap ? &b[0] :
+                                  distance (p, b[order - 1]) <= snap ? &b[order - 1] : nullptr;
+    if (a_end && b_end) {
+      /* Still remember it, so its duplicates are skipped. */
+      scratch.splits.push_back ({~0u, 0, p});
+      continue;
+    }
+    if (a_end)
+      p = *a_end;
+    if (b_end)
+      p = *b_end;
+    scratch.splits.push_back ({a_end ? ~0u : i, ta, p});
+    scratch.splits.push_back ({b_end ? ~0u : j, tb, p});
+  }
+  return true;
+}
+
+
+/*
+ * Overlap removal
+ */
+
+bool
+glyphy_remove_overlaps (glyphy_curves_t          &curves,
+                        glyphy_overlap_scratch_t &scratch)
+{
+  unsigned int num_curves = curves.size ();
+  if (num_curves < 2)
+    return false;
+
+  unsigned int order = curves.cubic ? 4 : 3;
+  scratch.points.resize (4 * num_curves);
+  scratch.boxes.resize (4 * num_curves);
+  double extents[4] = {INFINITY, INFINITY, -INFINITY, -INFINITY};
+  for (unsigned int i = 0; i < num_curves; i++) {
+    glyphy_point_t *c = &scratch.points[4 * i];
+    glyphy_curve_t curve = curves[i];
+    c[0] = curve.p1;
+    c[1] = curve.p2;
+    if (curves.cubic) {
+      c[2] = curves.fixed ? glyphy_point_t {glyphy_dequantize (curves.qxc[i]),
+                                            glyphy_dequantize (curves.qyc[i])}
+                          : glyphy_point_t {curves.xc[i], curves.yc[i]};
+      c[3] = curve.p3;
+    } else
+      c[2] = curve.p3;
+
+    double *box = &scratch.boxes[4 * i];
+    control_box (c, order, box);
+    extents[0] = std::min (extents[0], box[0]);
+    extents[1] = std::min (extents[1], box[1]);
+    extents[2] = std::max (extents[2], box[2]);
+    extents[3] = std::max (extents[3], box[3]);
+  }
+  double size = std::max (extents[2] - extents[0], extents[3] - extents[1]);
+  if (!(size > 0))
+    return false;
+  double tolerance = size * GLYPHY_OVERLAP_TOLERANCE;
+
+  /* Split curves where they cross. */
+  scratch.splits.clear ();
+  for (unsigned int i = 0; i < num_curves; i++)
+    for (unsigned int j = i + 1; j < num_curves; j++)
+      if (boxes_overlap (&scratch.boxes[4 * i], &scratch.boxes[4 * j]) &&
+          !find_splits (scratch, i, j, order, tolerance))
+        return false;
+
+  std::vector<glyphy_overlap_split_t> &splits = scratch.splits;
+  std::sort (splits.begin (), splits.end (),
+             [] (const glyphy_overlap_split_t &a, const glyphy_overlap_split_t &b)
+             { return a.curve < b.curve || (a.curve == b.curve && a.t < b.t); });
+
+  scratch.pieces.clear ();
+  unsigned int s = 0;
+  for (unsigned int i = 0; i < num_curves; i++) {
+    glyphy_point_t c[4];
+    std::copy (&scratch.points[4 * i], &scratch.points[4 * i] + order, c);
+    double done = 0;
+    for (; s < splits.size () && splits[s].curve == i; s++) {
+      const glyphy_overlap_split_t &split = splits[s];
+      if (s && splits[s - 1].curve == i &&
+          splits[s - 1].p.x == split.p.x && splits[s - 1].p.y == split.p.y)
+        continue;
+      double t = (split.t - done) / (1 - done);
+      if (!(t > 0 && t < 1))
+        return false;
+
+      glyphy_point_t left[4], right[4];
+      glyphy_bezier_split (c, order, t, left, right);
+      left[order - 1] = right[0] = split.p;
+      scratch.pieces.insert (scratch.pieces.end (), left, left + 4);
+      std::copy (right, right + 4, c);
+      done = split.t;
+    }
+    scratch.pieces.insert (scratch.pieces.end (), c, c + 4);
+  }
+
+  /* Keep the pieces with filled space on one side only, and check that
+   * they close up. */
+  unsigned int num_pieces = scratch.pieces.size () / 4;
+  unsigned int num_kept = 0;
+  scratch.ends.clear ();
+  for (unsigned int i = 0; i < num_pieces; i++) {
+    glyphy_point_t *c = &scratch.pieces[4 * i];
+    glyphy_point_t d;
+    glyphy_point_t m = glyphy_bezier_eval (c, order, .5, &d);
+    double length = hypot (d.x, d.y);
+    double offset = std::min (size * GLYPHY_OVERLAP_SAMPLE_OFFSET,
+                              .25 * distance (c[0], c[order - 1]));
+    bool keep = false;
+    if (length > 0 && offset > 0) {
+      glyphy_point_t normal = {-d.y / length * offset, d.x / length * offset};
+      int left = glyphy_winding_number (scratch.points.data (), scratch.boxes.data (),
+                                        num_curves, order, {m.x + normal.x, m.y + normal.y});
+      int right = glyphy_winding_number (scratch.points.data (), scratch.boxes.data (),
+                                         num_curves, order, {m.x - normal.x, m.y - normal.y});
+      keep = (left != 0) != (right != 0);
+    }
+    if (!keep) {
+      /* Mark as dropped. */
+      c[0].x = NAN;
+      continue;
+    }
+    num_kept++;
+    scratch.ends.push_back ({c[0], +1});
+    scratch.ends.push_back ({c[order - 1], -1});
+  }
+  /* Nothing inside, or splitting costs more curves than it saves. */
+  if (num_kept == num_pieces || num_kept > num_curves)
+    return false;
+
+  std::vector<glyphy_overlap_end_t> &ends = scratch.ends;
+  std::sort (ends.begin (), ends.end (),
+             [] (const glyphy_overlap_end_t &a, const glyphy_overlap_end_t &b)
+             { return a.p.x < b.p.x || (a.p.x == b.p.x && a.p.y < b.p.y); });
+  for (unsigned int i = 0; i < ends.size ();) {
+    int sum = 0;
+    unsigned int j = i;
+    for (; j < ends.size () && ends[j].p.x == ends[i].p.x && ends[j].p.y == ends[i].p.y; j++)
+      sum += ends[j].d;
+    if (sum)
+      return false;
+    i = j;
+  }
+
+  curves.clear ();
+  curves.reserve (num_kept);
+  for (unsigned int i = 0; i < num_pieces; i++) {
+    const glyphy_point_t *c = &scratch.pieces[4 * i];
+    if (std::isnan (c[0].x))
+      continue;
+    /* Pieces lie within the curves they came from, so they fit. */
+    if (curves.cubic)
+      curves.push_back_cubic (c);
+    else
+      curves.push_back ({c[0], c[1], c[2]});
+  }
+  return true;
+}
@@ -0,0 +1,276 @@
+/*
+ * Copyright 2026 Behdad Esfahbod. All Rights Reserved.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "glyphy.h"
+#include "glyphy.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/*
+ * Encode a list of glyphs on several threads.
+ *
+ * The glyph list is cut into one contiguous range per worker.  Workers
+ * take glyphs from the front of their own range; once that runs dry,
+ * they steal the back half of the largest range left.  Each worker
+ * encodes into its own storage, and blobs are laid out in glyph order
+ * only after all workers are done, so the output is the same as that of
+ * glyphy_encode_batch() no matter the thread count or scheduling.
+ *
+ * Glyphs that fail are marked and skipped.  Blobs that do not fit the
+ * caller's buffer are laid out in g instead, for
+ * glyphy_copy_parallel_blobs(), so that a larger buffer does not mean
+ * encoding everything again.
+ */
+
+
+struct worker_t
+{
+  std::mutex   lock;
+  unsigned int start;
+  unsigned int end;
+
+  glyphy_t *g;
+  void *user_data;
+
+  std::vector<glyphy_texel_t> texels;
+  unsigned int used;
+};
+
+struct job_t
+{
+  glyphy_get_glyph_shape_func_t get_glyph_shape;
+  const unsigned int *glyphs;
+  glyphy_glyph_blob_t *blobs;
+  unsigned int *glyph_worker;
+
+  worker_t *workers;
+  unsigned int num_workers;
+};
+
+static bool
+take_glyph (worker_t *w, unsigned int *index)
+{
+  std::lock_guard<std::mutex> guard (w->lock);
+  if (w->start == w->end)
+    return false;
+  *index = w->start++;
+  return true;
+}
+
+static bool
+steal_glyphs (job_t *job, worker_t *thief)
+{
+  for (;;)
+  {
+    worker_t *victim = nullptr;
+    unsigned int most = 0;
+    for (unsigned int i = 0; i < job->num_workers; i++)
+    {
+      worker_t *w = &job->workers[i];
+      if (w == thief)
+        continue;
+      std::lock_guard<std::mutex> guard (w->lock);
+      if (w->end - w->start > most)
+      {
+        most = w->end - w->start;
+        victim = w;
+      }
+    }
+    if (!victim)
+      return false;
+
+    unsigned int start, end;
+    {
+      std::lock_guard<std::mutex> guard (victim->lock);
+      unsigned int remaining = victim->end - victim->start;
+      if (!remaining)
+        continue; /* Raced with the owner or another thief; look again. */
+      end = victim->end;
+      start = end - (remaining + 1) / 2;
+      victim->end = start;
+    }
+
+    std::lock_guard<std::mutex> guard (thief->lock);
+    thief->start = start;
+    thief->end = end;
+    return true;
+  }
+}
+
+static void
+run_worker (job_t *job, worker_t *w)
+{
+  unsigned int index;
+
+  for (;;)
+  {
+    if (!take_glyph (w, &index))
+    {
+      if (!steal_glyphs (job, w))
+        break;
+      continue;
+    }
+
+    glyphy_glyph_blob_t *blob = &job->blobs[index];
+    unsigned int len;
+    job->glyph_worker[index] = w - job->workers;
+
+    glyphy_reset (w->g);
+    bool ok = job->get_glyph_shape (w->g, job->glyphs[index], w->user_data) &&
+              glyphy_successful (w->g) &&
+              glyphy_encode_size (w->g, &len);
+    if (ok)
+    {
+      if (w->texels.size () - w->used < len)
+        w->texels.resize (std::max ((size_t) w->used + len, 2 * w->texels.size ()));
+
+      ok = glyphy_encode (w->g,
+                          w->texels.data () + w->used,
+                          w->texels.size () - w->used,
+                          &blob->length,
+                          &blob->extents);
+    }
+    if (!ok)
+    {
+      blob->length = 0;
+      blob->num_curves = 0;
+      glyphy_extents_clear (&blob->extents);
+      blob->offset = w->used;
+      blob->failed = true;
+      continue;
+    }
+
+    blob->offset = w->used;
+    blob->num_curves = glyphy_get_num_curves (w->g);
+    blob->failed = false;
+    w->used += blob->length;
+  }
+}
+
+glyphy_bool_t
+glyphy_encode_parallel (glyphy_t                      *g,
+                        unsigned int                   num_threads,
+                        glyphy_get_glyph_shape_func_t  get_glyph_shape,
+                        void * const                  *user_data,
+                        const unsigned int            *glyphs,
+                        unsigned int                   num_glyphs,
+                        glyphy_texel_t                *buffer,
+                        unsigned int                   buffer_size,
+                        unsigned int                  *output_len,
+                        glyphy_glyph_blob_t           *blobs)
+{
+  *output_len = 0;
+  std::vector<glyphy_texel_t> ().swap (g->parallel_blobs);
+  if (!num_glyphs)
+    return true;
+
+  unsigned int num_workers = std::max (std::min (num_threads, num_glyphs), 1u);
+  std::vector<worker_t> workers (num_workers);
+  std::vector<unsigned int> glyph_worker (num_glyphs);
+
+  job_t job;
+  job.get_glyph_shape = get_glyph_shape;
+  job.glyphs = glyphs;
+  job.blobs = blobs;
+  job.glyph_worker = glyph_worker.data ();
+  job.workers = workers.data ();
+  job.num_workers = num_workers;
+
+  for (unsigned int i = 0; i < num_workers; i++)
+  {
+    worker_t *w = &workers[i];
+    w->start = (uint64_t) num_glyphs * i / num_workers;
+    w->end = (uint64_t) num_glyphs * (i + 1) / num_workers;
+    if (i)
+    {
+      w->g = glyphy_create ();
+      glyphy_set_flags (w->g, glyphy_get_flags (g));
+      glyphy_set_max_blob_len (w->g, glyphy_get_max_blob_len (g));
+      glyphy_set_cu2qu_tolerance (w->g, glyphy_get_cu2qu_tolerance (g));
+    }
+    else
+      w->g = g;
+    w->user_data = user_data[i];
+    w->used = 0;
+  }
+
+  /* The calling thread is worker 0. */
+  std::vector<std::thread> threads;
+  threads.reserve (num_workers - 1);
+  for (unsigned int i = 1; i < num_workers; i++)
+    threads.push_back (std::thread (run_worker, &job, &workers[i]));
+  run_worker (&job, &workers[0]);
+  for (std::thread &t : threads)
+    t.join ();
+
+  for (unsigned int i = 1; i < num_workers; i++)
+    glyphy_destroy (workers[i].g);
+
+  /* Lay out blobs in glyph order. */
+  bool failed = false;
+  uint64_t total_len = 0;
+  for (unsigned int i = 0; i < num_glyphs; i++)
+  {
+    failed = failed || blobs[i].failed;
+    total_len += blobs[i].length;
+  }
+  if (total_len > std::numeric_limits<unsigned int>::max ())
+  {
+    *output_len = std::numeric_limits<unsigned int>::max ();
+    return false;
+  }
+  bool fits = total_len <= buffer_size;
+  if (!fits)
+  {
+    g->parallel_blobs.resize (total_len);
+    buffer = g->parallel_blobs.data ();
+  }
+
+  unsigned int offset = 0;
+  for (unsigned int i = 0; i < num_glyphs; i++)
+  {
+    glyphy_glyph_blob_t *blob = &blobs[i];
+    const worker_t *w = &workers[glyph_worker[i]];
+
+    /* Empty and failed glyphs may come from a worker with no texels,
+     * and a NULL source is undefined even for memcpy() of nothing. */
+    if (blob->length)
+      memcpy (buffer + offset,
+              w->texels.data () + blob->offset,
+              blob->length * sizeof (glyphy_texel_t));
+    blob->offset = offset;
+    offset += blob->length;
+  }
+
+  *output_len = offset;
+  return fits && !failed;
+}
+
+glyphy_bool_t
+glyphy_copy_parallel_blobs (glyphy_t       *g,
+                            glyphy_texel_t *buffer,
+                            unsigned int    buffer_size)
+{
+  if (g->parallel_blobs.empty () ||
+      g->parallel_blobs.size () > buffer_size)
+    return false;
+
+  memcpy (buffer,
+          g->parallel_blobs.data (),
+          g->parallel_blobs.size () * sizeof (glyphy_texel_t));
+  std::vector<glyphy_texel_t> ().swap (g->parallel_blobs);
+  return true;
+}
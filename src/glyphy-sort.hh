@@ -0,0 +1,106 @@
+/*
+ * Copyright 2026 Behdad Esfahbod. All Rights Reserved.
+ *
+ */
+
+#ifndef GLYPHY_SORT_HH
+#define GLYPHY_SORT_HH
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+
+/*
+ * Stable sorts of curve indices by 16-bit key, for the band lists.
+ *
+ * Keys are quantized blob coordinates, so a radix sort over two 8-bit
+ * digits orders them in linear time.  Short lists, which is most bands,
+ * use insertion sort instead.
+ */
+
+struct glyphy_sort_item_t {
+  uint16_t     key;
+  unsigned int value;
+};
+
+/* Map a quantized coordinate to a key that sorts it ascending, or
+ * descending. */
+static inline uint16_t
+glyphy_sort_key (int16_t v, bool descending)
+{
+  uint16_t key = (uint16_t) v ^ 0x8000u;
+  return descending ? (uint16_t) ~key : key;
+}
+
+/* Below this many items insertion sort beats the radix passes. */
+#define GLYPHY_RADIX_SORT_THRESHOLD 64
+
+static inline void
+glyphy_insertion_sort (glyphy_sort_item_t *items,
+                       unsigned int        count)
+{
+  for (unsigned int i = 1; i < count; i++) {
+    glyphy_sort_item_t item = items[i];
+    unsigned int j = i;
+    for (; j && items[j - 1].key > item.key; j--)
+      items[j] = items[j - 1];
+    items[j] = item;
+  }
+}
+
+/* Stable sort by key.  tmp must have room for count items. */
+static inline void
+glyphy_radix_sort (glyphy_sort_item_t *items,
+                   glyphy_sort_item_t *tmp,
+                   unsigned int        count)
+{
+  if (count <= GLYPHY_RADIX_SORT_THRESHOLD) {
+    glyphy_insertion_sort (items, count);
+    return;
+  }
+
+  unsigned int offsets[2][256] = {};
+  for (unsigned int i = 0; i < count; i++) {
+    offsets[0][items[i].key & 0xFF]++;
+    offsets[1][items[i].key >> 8]++;
+  }
+
+  glyphy_sort_item_t *src = items, *dst = tmp;
+  for (unsigned int pass = 0; pass < 2; pass++) {
+    unsigned int shift = pass * 8;
+    unsigned int *digit_offsets = offsets[pass];
+
+    /* All keys share this digit; nothing to do. */
+    if (digit_offsets[(src[0].key >> shift) & 0xFF] == count)
+      continue;
+
+    unsigned int sum = 0;
+    for (unsigned int d = 0; d < 256; d++) {
+      unsigned int n = digit_offsets[d];
+      digit_offsets[d] = sum;
+      sum += n;
+    }
+
+    for (unsigned int i = 0; i < count; i++)
+      dst[digit_offsets[(src[i].key >> shift) & 0xFF]++] = src[i];
+    std::swap (src, dst);
+  }
+
+  if (src != items)
+    memcpy (items, src, count * sizeof (*items));
+}
+
+/* Comparison sort with the same result as glyphy_radix_sort(), for
+ * reference. */
+static inline void
+glyphy_comparison_sort (glyphy_sort_item_t *items,
+                        unsigned int        count)
+{
+  std::stable_sort (items, items + count,
+                    [] (const glyphy_sort_item_t &a, const glyphy_sort_item_t &b) {
+                      return a.key < b.key;
+                    });
+}
+
+#endif /* GLYPHY_SORT_HH */
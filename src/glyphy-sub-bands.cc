@@ -0,0 +1,221 @@
+/*
+ * Copyright 2026 Behdad Esfahbod. All Rights Reserved.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "glyphy.h"
+#include "glyphy.hh"
+
+#include <algorithm>
+#include <cmath>
+
+
+/*
+ * Sub-bands (GLYPHY_FLAG_SUB_BANDS), for paths with hundreds or
+ * thousands of curves.
+ *
+ * Flat bands hold every curve that crosses them, and a fragment tests
+ * all of those on its side of the band's split.  With many curves that
+ * is too many per fragment, and the index lists outgrow 16-bit offsets.
+ *
+ * Here the bands are many and thin, and each is split along the ray
+ * into sub-cells.  A fragment casts its ray from its sub-cell.  The
+ * curves the ray meets past the sub-cell only count whole there, as
+ * long as none of them starts, ends or turns back across the ray
+ * within the band: then they cross every ray in the band the same
+ * way, and the sub-cell stores their winding instead of a list entry.
+ * The rest, and everything touching the sub-cell, go in its list.
+ *
+ * Lists include curves up to a quarter of a sub-cell's width beyond
+ * its ends, so curves next to the sub-cell still get partial coverage
+ * as long as a sub-cell is at least two pixels wide.
+ *
+ * Work is in blob units, with the ray axis first: x for h-bands, y for
+ * v-bands.
+ */
+
+/* Aim for this many curves per sub-cell, and at most this many
+ * sub-cells per band.  Curves that end or turn within a band go into
+ * every sub-cell before them, so more sub-cells cost texels fast. */
+#define GLYPHY_SUB_BAND_CELL_CURVES 16
+#define GLYPHY_SUB_BAND_MAX_CELLS 8
+
+/* Lists reach this fraction of a sub-cell's width beyond its ends. */
+#define GLYPHY_SUB_BAND_PAD .25
+
+
+/* Range of n equal spans of size from origin whose closed ranges meet
+ * [lo, hi]. */
+static inline void
+span_range (double lo, double hi,
+            double origin, double size, int n,
+            int *first, int *last)
+{
+  *first = std::max ((int) ceil ((lo - origin) / size) - 1, 0);
+  *last = std::min ((int) floor ((hi - origin) / size), n - 1);
+}
+
+/* Whether the curve starts, ends or turns back across the ray
+ * direction within [lo, hi], so that rays across that range do not all
+ * cross it the same way. */
+static bool
+turns_within (const glyphy_point_t *c, unsigned int order,
+              double lo, double hi)
+{
+  double v[3] = {c[0].y, c[order - 1].y, c[0].y};
+  if (order == 3) {
+    /* Quadratic extremum across the ray. */
+    double t[2];
+    if (glyphy_bezier_turns (c, order, true, t))
+      v[2] = glyphy_bezier_eval (c, order, t[0]).y;
+  }
+  /* Cubics are monotonic already, see glyphy_emit_cubic(). */
+  for (unsigned int k = 0; k < 3; k++)
+    if (v[k] >= lo && v[k] <= hi)
+      return true;
+  return false;
+}
+
+void
+glyphy_build_sub_bands (const glyphy_curves_t      &curves,
+                        const glyphy_curve_info_t  *infos,
+                        const glyphy_extents_t     &extents,
+                        bool                        vertical,
+                        unsigned int                num_bands,
+                        glyphy_sub_bands_scratch_t &sub,
+                        bool                        keep_cells)
+{
+  unsigned int num_curves = curves.size ();
+  unsigned int order = curves.cubic ? 4 : 3;
+
+  double ray_start = glyphy_quantize (vertical ? extents.min_y : extents.min_x);
+  double ray_end = glyphy_quantize (vertical ? extents.max_y : extents.max_x);
+  double bands_start = glyphy_quantize (vertical ? extents.min_x : extents.min_y);
+  double bands_end = glyphy_quantize (vertical ? extents.max_x : extents.max_y);
+  if (!(bands_end > bands_start))
+    num_bands = 1;
+  double band_size = std::max (bands_end - bands_start, 1.) / num_bands;
+
+  /* Curves with the ray axis first, and the bands each overlaps. */
+  sub.points.resize (4 * num_curves);
+  sub.boxes.resize (4 * num_curves);
+  sub.band_counts.assign (num_bands, 0);
+  for (unsigned int i = 0; i < num_curves; i++) {
+    glyphy_point_t *c = &sub.points[4 * i];
+    glyphy_get_blob_points (curves, i, c);
+    const glyphy_curve_info_t &info = infos[i];
+    double *box = &sub.boxes[4 * i];
+    if (vertical) {
+      for (unsigned int k = 0; k < order; k++)
+        std::swap (c[k].x, c[k].y);
+      box[0] = info.qmin_y; box[1] = info.qmin_x;
+      box[2] = info.qmax_y; box[3] = info.qmax_x;
+    } else {
+      box[0] = info.qmin_x; box[1] = info.qmin_y;
+      box[2] = info.qmax_x; box[3] = info.qmax_y;
+    }
+
+    /* Lines along the ray never cross it. */
+    if (box[1] == box[3])
+      continue;
+    int lo, hi;
+    span_range (box[1], box[3], bands_start, band_size, num_bands, &lo, &hi);
+    for (int b = lo; b <= hi; b++)
+      sub.band_counts[b]++;
+  }
+
+  sub.band_offsets.resize (num_bands);
+  unsigned int total = 0;
+  for (unsigned int b = 0; b < num_bands; b++) {
+    sub.band_offsets[b] = total;
+    total += sub.band_counts[b];
+  }
+  sub.band_curves.resize (total);
+  for (unsigned int b = 0; b < num_bands; b++)
+    sub.band_counts[b] = 0;
+  for (unsigned int i = 0; i < num_curves; i++) {
+    const double *box = &sub.boxes[4 * i];
+    if (box[1] == box[3])
+      continue;
+    int lo, hi;
+    span_range (box[1], box[3], bands_start, band_size, num_bands, &lo, &hi);
+    for (int b = lo; b <= hi; b++)
+      sub.band_curves[sub.band_offsets[b] + sub.band_counts[b]++] = i;
+  }
+
+  /* Split each band into sub-cells and fill in their lists. */
+  sub.num_bands = num_bands;
+  sub.band_cells.resize (num_bands);
+  sub.cell_counts.clear ();
+  sub.cell_offsets.clear ();
+  sub.cell_windings.clear ();
+  sub.curves.clear ();
+  sub.index_len = 0;
+  for (unsigned int b = 0; b < num_bands; b++) {
+    const unsigned int *band = &sub.band_curves[sub.band_offsets[b]];
+    unsigned int count = sub.band_counts[b];
+    unsigned int num_cells = keep_cells ? sub.band_cells[b] :
+                             std::min (std::max ((count + GLYPHY_SUB_BAND_CELL_CURVES - 1) /
+                                                 GLYPHY_SUB_BAND_CELL_CURVES, 1u),
+                                       (unsigned int) GLYPHY_SUB_BAND_MAX_CELLS);
+    sub.band_cells[b] = num_cells;
+
+    /* One blob unit of slack on either side of the band, for rounding
+     * in the shader's choice of band. */
+    double band_lo = bands_start + band_size * b;
+    double band_hi = band_lo + band_size;
+    double band_center = .5 * (band_lo + band_hi);
+    sub.partial.resize (count);
+    for (unsigned int k = 0; k < count; k++)
+      sub.partial[k] = turns_within (&sub.points[4 * band[k]], order, band_lo - 1, band_hi + 1);
+
+    double cell_size = std::max (ray_end - ray_start, 1.) / num_cells;
+    for (unsigned int c = 0; c < num_cells; c++) {
+      double cell_lo = ray_start + cell_size * (c - GLYPHY_SUB_BAND_PAD);
+      double cell_hi = ray_start + cell_size * (c + 1 + GLYPHY_SUB_BAND_PAD);
+      glyphy_point_t past = {cell_hi, band_center};
+      int winding = 0;
+      unsigned int offset = sub.curves.size ();
+
+      for (unsigned int k = 0; k < count; k++) {
+        unsigned int i = band[k];
+        const double *box = &sub.boxes[4 * i];
+        /* Entirely behind every ray from the sub-cell. */
+        if (box[2] < cell_lo)
+          continue;
+        if (box[0] > cell_hi && !sub.partial[k]) {
+          winding += glyphy_winding_number (&sub.points[4 * i], box, 1, order, past);
+          continue;
+        }
+        sub.curves.push_back (i);
+      }
+
+      unsigned int cell_count = sub.curves.size () - offset;
+      if (sub.sort_items.size () < cell_count) {
+        sub.sort_items.resize (cell_count);
+        sub.sort_tmp.resize (cell_count);
+      }
+      for (unsigned int k = 0; k < cell_count; k++) {
+        unsigned int i = sub.curves[offset + k];
+        sub.sort_items[k].key = glyphy_sort_key ((int16_t) sub.boxes[4 * i + 2], true);
+        sub.sort_items[k].value = i;
+      }
+      glyphy_radix_sort (sub.sort_items.data (), sub.sort_tmp.data (), cell_count);
+      for (unsigned int k = 0; k < cell_count; k++)
+        sub.curves[offset + k] = sub.sort_items[k].value;
+
+      sub.cell_counts.push_back (cell_count);
+      sub.cell_offsets.push_back (offset);
+      /* The shader sums rightward crossings with the opposite sign;
+       * swapping the axes for v-bands undoes that. */
+      sub.cell_windings.push_back (vertical ? winding : -winding);
+      /* Two 32-bit curve offsets per index texel. */
+      sub.index_len += (cell_count + 1) / 2;
+    }
+  }
+  sub.num_cells = sub.cell_counts.size ();
+}
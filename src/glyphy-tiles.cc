@@ -0,0 +1,397 @@
+/*
+ * Copyright 2026 Behdad Esfahbod. All Rights Reserved.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "glyphy.h"
+#include "glyphy.hh"
+
+#include <algorithm>
+#include <cmath>
+
+
+/*
+ * Tiles (glyphy_encode_tiles()).
+ *
+ * The path is split into a quadtree of rectangles.  Each tile gets the
+ * path clipped to its rectangle grown by a margin, one side at a time:
+ * where a contour leaves across the side and comes back, the two
+ * crossings are joined along the side.  The part cut off and the join
+ * make a closed loop outside, so winding numbers inside do not change.
+ * The margin is sized in pixels at the smallest size the caller draws
+ * at, so the joins stay out of reach of the antialiasing of pixels
+ * inside the tile at that size and larger.  A fixed fraction of the
+ * tile would not do: small tiles drawn small put the joins within half
+ * a pixel of their edges.
+ *
+ * A tile's blob is encoded relative to the center of its rectangle,
+ * rounded to blob units so that curves quantize as they would in one
+ * blob.
+ */
+
+/* Tiles are split while they have more curves than this, or do not
+ * encode. */
+#define GLYPHY_TILE_MAX_CURVES 256
+#define GLYPHY_TILE_MAX_DEPTH 6
+
+/* Clip rectangles reach this many pixels past the tile at the smallest
+ * size.  Antialiasing reaches half a pixel; the rest covers rounding to
+ * blob units and fwidth() varying across the tile. */
+#define GLYPHY_TILE_MARGIN 1.
+
+
+static inline double
+coord (const glyphy_point_t &p, bool axis)
+{
+  return axis ? p.y : p.x;
+}
+
+static inline void
+set_coord (glyphy_point_t &p, bool axis, double v)
+{
+  (axis ? p.y : p.x) = v;
+}
+
+/* Coordinate axis of curve c at t, minus v. */
+static inline double
+eval (const glyphy_point_t *c, unsigned int order, bool axis, double v, double t)
+{
+  return coord (glyphy_bezier_eval (c, order, t), axis) - v;
+}
+
+/* Parameters in (0, 1), in order, where curve c crosses coordinate v
+ * on axis.  Returns how many. */
+static unsigned int
+crossings (const glyphy_point_t *c, unsigned int order, bool axis, double v,
+           double t[3])
+{
+  /* Split where the coordinate turns, so each span crosses at most
+   * once. */
+  double ends[4] = {0};
+  unsigned int num_ends = 1 + glyphy_bezier_turns (c, order, axis, ends + 1);
+  ends[num_ends++] = 1;
+
+  unsigned int n = 0;
+  for (unsigned int i = 0; i + 1 < num_ends; i++) {
+    double lo = ends[i], hi = ends[i + 1];
+    double flo = eval (c, order, axis, v, lo);
+    double fhi = eval (c, order, axis, v, hi);
+    if (!((flo < 0 && fhi > 0) || (flo > 0 && fhi < 0)))
+      continue;
+    for (unsigned int k = 0; k < 64 && hi - lo > 1e-15; k++) {
+      double mid = .5 * (lo + hi);
+      double fmid = eval (c, order, axis, v, mid);
+      if ((fmid < 0) == (flo < 0))
+        lo = mid;
+      else
+        hi = mid;
+    }
+    t[n++] = .5 * (lo + hi);
+  }
+  return n;
+}
+
+/* Appends curve c to out, joined along the clip side to where the
+ * last one kept ended. */
+static void
+append (glyphy_tile_path_t   &out,
+        unsigned int          order,
+        const glyphy_point_t *c,
+        bool                 &have_last,
+        glyphy_point_t       &last)
+{
+  if (have_last && (last.x != c[0].x || last.y != c[0].y)) {
+    glyphy_point_t line[4] = {last, last, c[0], c[0]};
+    out.points.insert (out.points.end (), line, line + 4);
+  }
+  out.points.insert (out.points.end (), c, c + order);
+  if (order == 3)
+    out.points.push_back (c[2]);
+  have_last = true;
+  last = c[order - 1];
+}
+
+/* Clips path in to the side of coordinate v on axis that keep_below
+ * says, into out. */
+static void
+clip (const glyphy_tile_path_t &in,
+      unsigned int              order,
+      bool                      axis,
+      double                    v,
+      bool                      keep_below,
+      glyphy_tile_path_t       &out)
+{
+  out.clear ();
+  double sign = keep_below ? 1 : -1;
+  unsigned int start = 0;
+  for (unsigned int end : in.contour_ends) {
+    unsigned int first = out.size ();
+    bool have_last = false;
+    glyphy_point_t last = {0, 0};
+
+    for (unsigned int i = start; i < end; i++) {
+      const glyphy_point_t *c = &in.points[4 * i];
+
+      bool all_in = true, all_out = true;
+      for (unsigned int k = 0; k < order; k++) {
+        double d = sign * (coord (c[k], axis) - v);
+        all_in = all_in && d <= 0;
+        all_out = all_out && d > 0;
+      }
+      if (all_out)
+        continue;
+      if (all_in) {
+        append (out, order, c, have_last, last);
+        continue;
+      }
+
+      /* Lines keep their control points on their ends. */
+      bool line = c[1].x == c[0].x && c[1].y == c[0].y;
+      double t[3];
+      unsigned int n = crossings (c, order, axis, v, t);
+      glyphy_point_t rest[4], piece[4], right[4];
+      std::copy (c, c + 4, rest);
+      double done = 0;
+      for (unsigned int k = 0; k <= n; k++) {
+        if (k < n) {
+          glyphy_bezier_split (rest, order, (t[k] - done) / (1 - done),
+                               piece, right);
+          set_coord (piece[order - 1], axis, v);
+          set_coord (right[0], axis, v);
+          std::copy (right, right + 4, rest);
+          done = t[k];
+        } else
+          std::copy (rest, rest + 4, piece);
+        if (line) {
+          piece[1] = piece[0];
+          if (order == 4)
+            piece[2] = piece[3];
+        }
+        if (sign * (eval (piece, order, axis, v, .5)) <= 0)
+          append (out, order, piece, have_last, last);
+      }
+    }
+
+    if (out.size () > first) {
+      /* Close the contour along the clip side. */
+      glyphy_point_t p = out.points[4 * first];
+      if (last.x != p.x || last.y != p.y) {
+        glyphy_point_t line[4] = {last, last, p, p};
+        out.points.insert (out.points.end (), line, line + 4);
+      }
+      out.contour_ends.push_back (out.size ());
+    }
+    start = end;
+  }
+}
+
+/* The accumulated curves of g, as a path of closed contours. */
+static void
+get_source_path (const glyphy_curves_t &curves, glyphy_tile_path_t &path)
+{
+  path.clear ();
+  unsigned int num_curves = curves.size ();
+  unsigned int order = curves.cubic ? 4 : 3;
+  path.points.reserve (4 * num_curves);
+  unsigned int first = 0;
+  for (unsigned int i = 0; i < num_curves; i++) {
+    glyphy_point_t c[4];
+    if (curves.fixed) {
+      int16_t q[8];
+      if (curves.cubic)
+        curves.get_quantized_cubic (i, q);
+      else
+        curves.get_quantized (i, q);
+      for (unsigned int k = 0; k < order; k++)
+        c[k] = {glyphy_dequantize (q[2 * k]), glyphy_dequantize (q[2 * k + 1])};
+    } else {
+      glyphy_curve_t q = curves[i];
+      c[0] = q.p1;
+      c[1] = q.p2;
+      c[order - 1] = q.p3;
+      if (curves.cubic)
+        c[2] = {curves.xc[i], curves.yc[i]};
+    }
+    if (order == 3)
+      c[3] = c[2];
+    path.points.insert (path.points.end (), c, c + 4);
+
+    if (i + 1 == num_curves || !curves.continues (i)) {
+      /* Close it with a line if it does not close itself. */
+      glyphy_point_t p = path.points[4 * first];
+      glyphy_point_t last = c[order - 1];
+      if (last.x != p.x || last.y != p.y) {
+        glyphy_point_t line[4] = {last, last, p, p};
+        path.points.insert (path.points.end (), line, line + 4);
+      }
+      path.contour_ends.push_back (path.size ());
+      first = path.size ();
+    }
+  }
+}
+
+/* Draws path, moved by -origin, into g. */
+static void
+draw_path (glyphy_t                 *g,
+           const glyphy_tile_path_t &path,
+           unsigned int              order,
+           const glyphy_point_t     &origin)
+{
+  glyphy_reset (g);
+  unsigned int start = 0;
+  for (unsigned int end : path.contour_ends) {
+    for (unsigned int i = start; i < end; i++) {
+      glyphy_point_t c[4];
+      for (unsigned int k = 0; k < order; k++)
+        c[k] = {path.points[4 * i + k].x - origin.x, path.points[4 * i + k].y - origin.y};
+      if (i == start)
+        glyphy_move_to (g, &c[0]);
+      if (order == 4)
+        glyphy_cubic_to (g, &c[1], &c[2], &c[3]);
+      else
+        glyphy_conic_to (g, &c[1], &c[2]);
+    }
+    glyphy_close_path (g);
+    start = end;
+  }
+}
+
+struct tiles_output_t {
+  double          margin;
+  glyphy_texel_t *blob;
+  unsigned int    blob_size;
+  unsigned int    len;
+  glyphy_tile_t  *tiles;
+  unsigned int    max_tiles;
+  unsigned int    num_tiles;
+};
+
+static bool
+encode_tile (glyphy_t               *g,
+             const glyphy_extents_t &rect,
+             unsigned int            depth,
+             tiles_output_t         &out)
+{
+  glyphy_tiles_scratch_t &scratch = g->tiles;
+  unsigned int order = g->curves.cubic ? 4 : 3;
+
+  double margin = out.margin;
+  const glyphy_tile_path_t &parent = depth ? scratch.levels[depth - 1] : scratch.source;
+  glyphy_tile_path_t &path = scratch.levels[depth];
+  clip (parent, order, false, rect.min_x - margin, false, scratch.tmp[0]);
+  clip (scratch.tmp[0], order, false, rect.max_x + margin, true, scratch.tmp[1]);
+  clip (scratch.tmp[1], order, true, rect.min_y - margin, false, scratch.tmp[0]);
+  clip (scratch.tmp[0], order, true, rect.max_y + margin, true, path);
+  if (!path.size ())
+    return true;
+
+  /* Splitting pays off while the children clip much less than this
+   * tile does: not once the margins are most of each child, nor when
+   * clipping to this tile dropped nothing from its parent.  Otherwise
+   * keep the tile whole if it encodes. */
+  bool split = depth < GLYPHY_TILE_MAX_DEPTH;
+  bool shrinks = std::max (rect.max_x - rect.min_x, rect.max_y - rect.min_y) > 2 * margin &&
+                 (!depth || path.size () < parent.size ());
+  unsigned int len = 0;
+  glyphy_point_t origin = {
+    round (.5 * (rect.min_x + rect.max_x) * GLYPHY_UNITS_PER_EM_UNIT) / GLYPHY_UNITS_PER_EM_UNIT,
+    round (.5 * (rect.min_y + rect.max_y) * GLYPHY_UNITS_PER_EM_UNIT) / GLYPHY_UNITS_PER_EM_UNIT};
+  if (!split || !shrinks || path.size () <= GLYPHY_TILE_MAX_CURVES) {
+    draw_path (scratch.g, path, order, origin);
+    if (glyphy_successful (scratch.g) && glyphy_encode_size (scratch.g, &len))
+      split = false;
+    else if (!split)
+      return false;
+  }
+
+  if (split) {
+    double mid_x = .5 * (rect.min_x + rect.max_x);
+    double mid_y = .5 * (rect.min_y + rect.max_y);
+    for (unsigned int i = 0; i < 4; i++) {
+      glyphy_extents_t child = rect;
+      if (i & 1)
+        child.min_x = mid_x;
+      else
+        child.max_x = mid_x;
+      if (i & 2)
+        child.min_y = mid_y;
+      else
+        child.max_y = mid_y;
+      if (!encode_tile (g, child, depth + 1, out))
+        return false;
+    }
+    return true;
+  }
+
+  if (out.num_tiles < out.max_tiles && out.len + len <= out.blob_size) {
+    glyphy_tile_t &tile = out.tiles[out.num_tiles];
+    glyphy_extents_t extents;
+    glyphy_encode (scratch.g, out.blob + out.len, len, &len, &extents);
+    tile.extents = rect;
+    tile.origin = origin;
+    tile.offset = out.len;
+    tile.length = len;
+  }
+  out.num_tiles++;
+  out.len += len;
+  return true;
+}
+
+glyphy_bool_t
+glyphy_encode_tiles (glyphy_t         *g,
+                     double            min_ppem,
+                     glyphy_texel_t   *blob,
+                     unsigned int      blob_size,
+                     unsigned int     *output_len,
+                     glyphy_extents_t *extents,
+                     glyphy_tile_t    *tiles,
+                     unsigned int      max_tiles,
+                     unsigned int     *num_tiles)
+{
+  *output_len = 0;
+  *num_tiles = 0;
+  glyphy_extents_clear (extents);
+  if (!g->success || !(min_ppem > 0))
+    return false;
+
+  unsigned int len;
+  if (g->curves.size () <= GLYPHY_TILE_MAX_CURVES &&
+      glyphy_encode_size (g, &len)) {
+    if (!len)
+      return true;
+    *output_len = len;
+    *num_tiles = 1;
+    if (!max_tiles || len > blob_size)
+      return false;
+    glyphy_encode (g, blob, blob_size, &len, extents);
+    tiles[0].extents = *extents;
+    tiles[0].origin = {0, 0};
+    tiles[0].offset = 0;
+    tiles[0].length = len;
+    return true;
+  }
+
+  glyphy_tiles_scratch_t &scratch = g->tiles;
+  if (!scratch.g)
+    scratch.g = glyphy_create ();
+  glyphy_set_flags (scratch.g, g->flags);
+  glyphy_set_max_blob_len (scratch.g, g->max_blob_len);
+  scratch.levels.resize (GLYPHY_TILE_MAX_DEPTH + 1);
+
+  get_source_path (g->curves, scratch.source);
+  const std::vector<glyphy_point_t> &points = scratch.source.points;
+  for (unsigned int i = 0; i < points.size (); i++)
+    glyphy_extents_add (extents, &points[i]);
+  if (glyphy_extents_is_empty (extents))
+    return true;
+
+  tiles_output_t out = {GLYPHY_TILE_MARGIN / min_ppem, blob, blob_size, 0, tiles, max_tiles, 0};
+  bool ok = encode_tile (g, *extents, 0, out);
+  *output_len = out.len;
+  *num_tiles = out.num_tiles;
+  return ok && out.num_tiles <= max_tiles && out.len <= blob_size;
+}
@@ -9,11 +9,23 @@
 /* Requires GLSL 3.30 */
 
 
+#ifndef GLYPHY_UNITS_PER_EM_UNIT
+#define GLYPHY_UNITS_PER_EM_UNIT 4
+#endif
+
+#define GLYPHY_INV_UNITS float(1.0 / float(GLYPHY_UNITS_PER_EM_UNIT))
+
+
+uniform isamplerBuffer u_atlas;
+
+
 /* Dilate a glyph vertex by half a pixel on screen.
  *
  * position:  object-space vertex position (modified in place)
  * texcoord:  em-space sample coordinates (modified in place)
- * normal:    object-space outward normal at this vertex
+ * normal:    object-space outward normal at this vertex; zero components
+ *            leave edges shared with another quad, such as between the
+ *            tiles of glyphy_encode_tiles(), in place
  * jac:       inverse of the 2x2 linear part of the em-to-object transform,
  *            stored row-major as (j00, j01, j10, j11).  Maps object-space
  *            displacements back to em-space for texcoord adjustment.
@@ -27,6 +39,9 @@ void glyphy_dilate (inout vec2 position, inout vec2 texcoord,
 		     vec2 normal, vec4 jac,
 		     mat4 m, vec2 viewport)
 {
+  if (normal == vec2 (0.0))
+    return;
+
   vec2 n = normalize (normal);
 
   vec4 clipPos = m * vec4 (position, 0.0, 1.0);
@@ -51,3 +66,29 @@ void glyphy_dilate (inout vec2 position, inout vec2 texcoord,
   position += dPos;
   texcoord += vec2 (dot (dPos, jac.xy), dot (dPos, jac.zw));
 }
+
+/* Decode a glyph's blob header once per vertex, instead of once per
+ * fragment in glyphy_render().  Pass the results to the fragment shader
+ * as flat varyings, and on to the glyphy_render() overload taking them.
+ *
+ * Requires the u_atlas uniform to be bound to the glyph atlas buffer.
+ *
+ * glyphLoc:       offset into u_atlas for this glyph's encoded blob
+ * ext:            em-space extents (min_x, min_y, max_x, max_y)
+ * bandTransform:  em-space to band index scale (xy) and offset (zw), for
+ *                 v-bands along x and h-bands along y
+ * header:         blob header texel 1: band counts, flags and cell grid
+ *                 offset
+ */
+void glyphy_decode_header (uint glyphLoc, out vec4 ext,
+			   out vec4 bandTransform, out ivec4 header)
+{
+  int loc = int (glyphLoc);
+  ext = vec4 (texelFetch (u_atlas, loc)) * GLYPHY_INV_UNITS;
+  header = texelFetch (u_atlas, loc + 1);
+
+  /* Quantized extents are empty or at least a unit wide. */
+  vec2 extSize = max (ext.zw - ext.xy, vec2 (GLYPHY_INV_UNITS));
+  vec2 bandScale = vec2 (float (header.g), float (header.r)) / extSize;
+  bandTransform = vec4 (bandScale, -ext.xy * bandScale);
+}
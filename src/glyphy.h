@@ -114,6 +114,122 @@ GLYPHY_API void
 glyphy_reset (glyphy_t *g);
 
 
+/* Encoding options.  Flags are kept across glyphy_reset(). */
+
+typedef enum {
+  GLYPHY_FLAG_DEFAULT          = 0x00000000u,
+
+  /* Store each curve's quantized bounds next to its index, one curve per
+   * index texel instead of four.  Index lists grow, but the shader can
+   * skip curves that miss the pixel row without fetching them, which
+   * pays off on glyphs with dense bands. */
+  GLYPHY_FLAG_BOUNDED_INDICES  = 0x00000001u,
+
+  /* Choose the number of bands per axis from an estimate of how many
+   * curves each fragment tests, instead of a fixed count.  Simple glyphs
+   * get fewer bands and smaller blobs, dense ones more bands and shorter
+   * shader loops.  See also glyphy_set_max_blob_len(). */
+  GLYPHY_FLAG_ADAPTIVE_BANDS   = 0x00000002u,
+
+  /* Place band edges so that curves spread evenly over the bands,
+   * rather than splitting the extents evenly, and store the edges in
+   * the blob.  Lowers the worst-case fragment cost of glyphs whose
+   * curves bunch up, at a few texels per glyph. */
+  GLYPHY_FLAG_BALANCED_BANDS   = 0x00000004u,
+
+  /* Quantize curves to blob coordinates as they are drawn, and keep
+   * them as 16-bit integers.  Accumulated outlines take a quarter of the
+   * memory, encoding does no float-to-int conversion and is exact, and
+   * curves that collapse to a point are dropped.  Drawing fails if a
+   * coordinate does not fit.  Changing this flag resets g. */
+  GLYPHY_FLAG_FIXED_POINT      = 0x00000008u,
+
+  /* Keep cubics drawn with glyphy_cubic_to() as cubics, instead of
+   * approximating them with quadratics, and encode every curve as a
+   * cubic that the shader solves directly.  CFF outlines take far fewer
+   * curves, and drawing skips cu2qu.  Curves are split where they turn
+   * in x or y, and quadratics are stored degree-elevated, exact to
+   * within blob rounding.  Changing this flag resets g. */
+  GLYPHY_FLAG_NATIVE_CUBICS    = 0x00000010u,
+
+  /* Before encoding, drop curves that collapse to a point in blob
+   * coordinates, and merge runs of lines that lie on one line there.
+   * Bands are still laid out for the curves as drawn, so the blob
+   * renders the same, with fewer curves to test, for the cost of
+   * laying out twice.  Helps outlines converted from cubics or traced
+   * from bitmaps.  Works on a copy: the accumulated curves stay as
+   * drawn, and encoding again, after changing settings, starts over
+   * from them.  glyphy_get_num_curves() reports what remains after
+   * encoding. */
+  GLYPHY_FLAG_SIMPLIFY         = 0x00000020u,
+
+  /* Before encoding, split curves where contours overlap and drop the
+   * pieces inside the filled area, leaving the outline of the union.
+   * Composite glyphs and variable-font outlines often overlap; their
+   * blobs get fewer curves per band and cover the same area.  Outlines
+   * that do not split cleanly, such as ones with contours running
+   * along each other, are left as they are.  Like
+   * GLYPHY_FLAG_SIMPLIFY, this works on a copy of the accumulated
+   * curves. */
+  GLYPHY_FLAG_REMOVE_OVERLAPS  = 0x00000040u,
+
+  /* Store a coarse grid over the glyph that marks cells no curve
+   * passes through as solid or empty.  Fragments well inside such a
+   * cell return full or no coverage without testing any curves, which
+   * pays off in the stems and counters of large text.  Costs eight
+   * texels per glyph; glyphs with no such cells go without. */
+  GLYPHY_FLAG_CELL_GRID        = 0x00000080u,
+
+  /* Split each band along its rays into sub-cells, with their own
+   * curve lists, and use many thinner bands.  The number of curves a
+   * fragment tests stays low as paths grow, at some texels per curve,
+   * and blobs can exceed the 32768 texels that flat bands address.
+   * For icons, maps and logos with hundreds or thousands of curves;
+   * paths with 1024 curves or more get this even without the flag.
+   * GLYPHY_FLAG_ADAPTIVE_BANDS, GLYPHY_FLAG_BALANCED_BANDS and
+   * GLYPHY_FLAG_BOUNDED_INDICES do not apply to sub-bands. */
+  GLYPHY_FLAG_SUB_BANDS        = 0x00000100u,
+
+  /* Store bands for one axis only, the one whose bands hold fewer
+   * curves, and have the shader cast rays along it alone.  Blobs lose
+   * the other axis' band lists, and fragments test about half as many
+   * curves, but edges along the rays antialias poorly.  For large text
+   * only.  See also glyphy_render() with a single-axis threshold, which
+   * does this per fragment with full blobs. */
+  GLYPHY_FLAG_SINGLE_AXIS      = 0x00000200u
+} glyphy_flags_t;
+
+/* flags is a bitwise-or of glyphy_flags_t values. */
+GLYPHY_API void
+glyphy_set_flags (glyphy_t     *g,
+                  unsigned int  flags);
+
+GLYPHY_API unsigned int
+glyphy_get_flags (glyphy_t *g);
+
+/* Limits the blob length, in texels, that GLYPHY_FLAG_ADAPTIVE_BANDS
+ * may spend on bands.  If no band counts fit, the smallest layout is
+ * used.  0, the default, means no limit.  Kept across glyphy_reset(). */
+GLYPHY_API void
+glyphy_set_max_blob_len (glyphy_t     *g,
+                         unsigned int  max_len);
+
+GLYPHY_API unsigned int
+glyphy_get_max_blob_len (glyphy_t *g);
+
+/* Sets how far, in font units, the quadratics that glyphy_cubic_to()
+ * emits may stray from the cubic.  Looser tolerances give fewer curves.
+ * To keep the error under 1/8 pixel at sizes up to max_ppem, use
+ * upem / (8 * max_ppem).  Values that are not positive restore the
+ * default, 0.5.  Kept across glyphy_reset(). */
+GLYPHY_API void
+glyphy_set_cu2qu_tolerance (glyphy_t *g,
+                            double    tolerance);
+
+GLYPHY_API double
+glyphy_get_cu2qu_tolerance (glyphy_t *g);
+
+
 /* Draw into glyphy */
 
 GLYPHY_API void
@@ -142,6 +258,67 @@ GLYPHY_API void
 glyphy_get_current_point (glyphy_t *g,
                           glyphy_point_t *point);
 
+/* Point tags for glyphy_append_outline().  The values are those of
+ * FT_CURVE_TAG(), so FreeType outline tags can be passed as they are;
+ * bits above the lowest two are ignored. */
+typedef enum {
+  GLYPHY_POINT_TAG_CONIC = 0, /* Quadratic control point */
+  GLYPHY_POINT_TAG_ON    = 1, /* On-curve point */
+  GLYPHY_POINT_TAG_CUBIC = 2  /* Cubic control point; they come in pairs */
+} glyphy_point_tag_t;
+
+/* Appends a whole outline in the layout of FT_Outline: contour i is
+ * points (contour_ends[i - 1], contour_ends[i]], with contour_ends[-1]
+ * taken as -1.  Contours are closed; two consecutive conic control
+ * points imply the on-curve point midway between them.  The result is
+ * the same as drawing the outline segment by segment, but curve
+ * storage is grown once up front.  Malformed outlines make
+ * glyphy_successful() return false. */
+GLYPHY_API void
+glyphy_append_outline (glyphy_t             *g,
+                       const glyphy_point_t *points,
+                       const unsigned char  *tags,
+                       unsigned int          num_points,
+                       const unsigned int   *contour_ends,
+                       unsigned int          num_contours);
+
+/* Appends num_quadratics quadratic Béziers; curve i is points[3i] to
+ * points[3i + 2], with points[3i + 1] as control point.  A curve whose
+ * start differs from the end of the previous one starts a new contour;
+ * contours are expected to be closed already.  Curves that start where
+ * they end are skipped. */
+GLYPHY_API void
+glyphy_append_quadratics (glyphy_t             *g,
+                          const glyphy_point_t *points,
+                          unsigned int          num_quadratics);
+
+/* TrueType outline data: the contents of a font's 'glyf', 'loca' and
+ * 'hmtx' tables, whether loca has long offsets (head.indexToLocFormat
+ * is 1), and hhea.numberOfHMetrics.  Without hmtx, glyphs are not
+ * moved to match their left side bearing, as FreeType and HarfBuzz
+ * do. */
+typedef struct {
+  const unsigned char *glyf;
+  unsigned int         glyf_len;
+  const unsigned char *loca;
+  unsigned int         loca_len;
+  glyphy_bool_t        long_loca;
+  const unsigned char *hmtx;
+  unsigned int         hmtx_len;
+  unsigned int         num_h_metrics;
+} glyphy_glyf_t;
+
+/* Appends the outline of glyph, in font units, read straight from the
+ * tables with no per-point callbacks.  Handles simple glyphs,
+ * including cubic points, and composite glyphs whose components are
+ * placed by offset.  Returns false and leaves g unchanged if the glyph
+ * is malformed or uses anything else, such as components attached by
+ * point numbers; draw it another way then. */
+GLYPHY_API glyphy_bool_t
+glyphy_glyf_append_glyph (glyphy_t            *g,
+                          const glyphy_glyf_t *tables,
+                          unsigned int         glyph);
+
 GLYPHY_API unsigned int
 glyphy_get_num_curves (glyphy_t *g);
 
@@ -151,6 +328,14 @@ glyphy_successful (glyphy_t *g);
 
 /* Encode accumulated curves into blob */
 
+/* Computes the exact blob length, in texels, that glyphy_encode() will
+ * produce for the current curves, without writing anything.  The band
+ * layout is kept and reused by a following glyphy_encode() call.
+ * Returns false if the curves cannot be encoded at all. */
+GLYPHY_API glyphy_bool_t
+glyphy_encode_size (glyphy_t     *g,
+                    unsigned int *output_len);
+
 GLYPHY_API glyphy_bool_t
 glyphy_encode (glyphy_t         *g,
                glyphy_texel_t   *blob,
@@ -159,6 +344,121 @@ glyphy_encode (glyphy_t         *g,
                glyphy_extents_t *extents);
 
 
+/* Encode a path as several blobs */
+
+typedef struct {
+  glyphy_extents_t extents; /* Area to draw the blob over */
+  glyphy_point_t   origin;  /* Subtract from em coordinates before sampling */
+  unsigned int     offset;  /* Blob start, in texels from buffer start */
+  unsigned int     length;  /* Blob length in texels */
+} glyphy_tile_t;
+
+/* Encodes the accumulated curves as one blob per tile, a rectangle of
+ * the path's extents, placed back to back.  Paths of up to 256 curves
+ * that glyphy_encode() can encode get a single tile; larger ones, and
+ * ones whose blob does not fit the format, are split in four until
+ * each tile has at most 256 curves or encodes, at most six times.
+ * Tiles that nothing reaches are left out.
+ *
+ * Draw each tile's blob over its extents only, sampling it at em
+ * coordinates minus its origin, so that coordinates stay in range.
+ * Tile edges inside the path must not be dilated; see glyphy_dilate().
+ * Each blob reaches a pixel past its tile at min_ppem, the smallest
+ * size the tiles will be drawn at, in pixels per em unit as the
+ * shaders measure them; tiles join seamlessly at that size and larger.
+ * Smaller sizes need wider margins, so tiles hold more curves and more
+ * of them may fail to encode.  min_ppem must be positive.
+ *
+ * Returns false if drawing failed, if a tile cannot be encoded, or if
+ * the blobs or tiles do not fit in blob or tiles.  In the latter case
+ * *output_len and *num_tiles are set to the sizes needed.
+ */
+GLYPHY_API glyphy_bool_t
+glyphy_encode_tiles (glyphy_t         *g,
+                     double            min_ppem,
+                     glyphy_texel_t   *blob,
+                     unsigned int      blob_size,
+                     unsigned int     *output_len,
+                     glyphy_extents_t *extents,
+                     glyphy_tile_t    *tiles,
+                     unsigned int      max_tiles,
+                     unsigned int     *num_tiles);
+
+
+/* Encode many glyphs back to back into one buffer */
+
+/* Draws the outline of glyph into g, which has already been reset.
+ * Returns false on failure. */
+typedef glyphy_bool_t (*glyphy_get_glyph_shape_func_t) (glyphy_t    *g,
+                                                        unsigned int glyph,
+                                                        void        *user_data);
+
+typedef struct {
+  unsigned int     offset;  /* Blob start, in texels from buffer start */
+  unsigned int     length;  /* Blob length in texels; 0 for empty glyphs */
+  unsigned int     num_curves;
+  glyphy_extents_t extents;
+  glyphy_bool_t    failed;  /* Glyph failed to draw or encode */
+} glyphy_glyph_blob_t;
+
+/* Encodes glyphs in order, placing each blob right after the previous
+ * one.  Blob offsets are relative to their own start, so the whole
+ * buffer can be uploaded to the atlas as is.
+ *
+ * Returns the number of glyphs encoded.  If that is less than
+ * num_glyphs, the next glyph failed to draw or encode; most commonly
+ * it did not fit in the remaining buffer space.  *output_len is set to
+ * the number of texels used by the encoded glyphs.
+ */
+GLYPHY_API unsigned int
+glyphy_encode_batch (glyphy_t                      *g,
+                     glyphy_get_glyph_shape_func_t  get_glyph_shape,
+                     void                          *user_data,
+                     const unsigned int            *glyphs,
+                     unsigned int                   num_glyphs,
+                     glyphy_texel_t                *buffer,
+                     unsigned int                   buffer_size,
+                     unsigned int                  *output_len,
+                     glyphy_glyph_blob_t           *blobs);
+
+/* Like glyphy_encode_batch(), but spreads the glyphs over num_threads
+ * threads, the calling thread being one of them.  Thread i calls
+ * get_glyph_shape with user_data[i]; thread 0 draws into g, the others
+ * into glyphy_t objects of their own that take on the settings of g.
+ * The output is identical to that of glyphy_encode_batch() regardless
+ * of num_threads, except that a glyph that fails to draw or encode does
+ * not stop the others: its blob gets failed set and a length of 0.
+ *
+ * blobs is filled in for every glyph and *output_len is set to the
+ * buffer size needed, even if the blobs do not fit in buffer.  They are
+ * then kept in g until glyphy_copy_parallel_blobs() or the next call.
+ *
+ * Returns false if any glyph failed, or if the blobs do not fit in
+ * buffer.
+ */
+GLYPHY_API glyphy_bool_t
+glyphy_encode_parallel (glyphy_t                      *g,
+                        unsigned int                   num_threads,
+                        glyphy_get_glyph_shape_func_t  get_glyph_shape,
+                        void * const                  *user_data,
+                        const unsigned int            *glyphs,
+                        unsigned int                   num_glyphs,
+                        glyphy_texel_t                *buffer,
+                        unsigned int                   buffer_size,
+                        unsigned int                  *output_len,
+                        glyphy_glyph_blob_t           *blobs);
+
+/* Copies the blobs of the last glyphy_encode_parallel() call on g that
+ * did not fit in its buffer to buffer, at the offsets that call gave
+ * them.  Returns false if there are none, or if buffer is smaller than
+ * the *output_len that call set.
+ */
+GLYPHY_API glyphy_bool_t
+glyphy_copy_parallel_blobs (glyphy_t       *g,
+                            glyphy_texel_t *buffer,
+                            unsigned int    buffer_size);
+
+
 #ifdef __cplusplus
 }
 #endif
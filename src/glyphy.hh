@@ -7,14 +7,656 @@
 #define GLYPHY_HH
 
 #include "glyphy.h"
+#include "glyphy-sort.hh"
+#include <cmath>
+#include <cstdint>
+#include <utility>
 #include <vector>
 
+/* Default maximum cu2qu approximation error in font units; see
+ * glyphy_set_cu2qu_tolerance().  0.5 is well below one unit in any
+ * reasonable coordinate system. */
+#ifndef GLYPHY_CU2QU_TOLERANCE
+#define GLYPHY_CU2QU_TOLERANCE 0.5
+#endif
+
+/* Sub-bands (GLYPHY_FLAG_SUB_BANDS): paths with at least this many
+ * curves get them without the flag. */
+#ifndef GLYPHY_SUB_BANDS_MIN_CURVES
+#define GLYPHY_SUB_BANDS_MIN_CURVES 1024
+#endif
+
+/* GLYPHY_FLAG_CELL_GRID: cells per axis of the grid over a glyph's
+ * extents.  Must match the shader's. */
+#ifndef GLYPHY_CELL_GRID_SIZE
+#define GLYPHY_CELL_GRID_SIZE 16
+#endif
+
 typedef struct {
   glyphy_point_t p1;
   glyphy_point_t p2;
   glyphy_point_t p3;
 } glyphy_curve_t;
 
+/* Blob coordinate of em-space value v. */
+static inline int16_t
+glyphy_quantize (double v)
+{
+  return (int16_t) round (v * GLYPHY_UNITS_PER_EM_UNIT);
+}
+
+static inline bool
+glyphy_quantize_fits_i16 (double v)
+{
+  double q = round (v * GLYPHY_UNITS_PER_EM_UNIT);
+  return q >= INT16_MIN && q <= INT16_MAX;
+}
+
+/* glyphy_quantize(), if the result fits; without calling round(). */
+static inline bool
+glyphy_quantize_checked (double v, int16_t *q)
+{
+  double x = v * GLYPHY_UNITS_PER_EM_UNIT;
+  if (!(x > INT16_MIN - 1. && x < INT16_MAX + 1.))
+    return false;
+  int t = (int) x;
+  double d = x - t;
+  t += (d >= .5) - (d <= -.5);
+  if (t < INT16_MIN || t > INT16_MAX)
+    return false;
+  *q = (int16_t) t;
+  return true;
+}
+
+static inline double
+glyphy_dequantize (int16_t v)
+{
+  return (double) v / GLYPHY_UNITS_PER_EM_UNIT;
+}
+
+/* Bézier curves, given order control points: 3 for quadratics, 4 for
+ * cubics. */
+
+static inline glyphy_point_t
+glyphy_lerp (const glyphy_point_t &a, const glyphy_point_t &b, double t)
+{
+  return {a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t};
+}
+
+/* Point of c at t, exact at the ends, and optionally the direction
+ * there (de Casteljau). */
+static inline glyphy_point_t
+glyphy_bezier_eval (const glyphy_point_t *c, unsigned int order, double t,
+                    glyphy_point_t *direction = nullptr)
+{
+  glyphy_point_t tmp[4];
+  for (unsigned int i = 0; i < order; i++)
+    tmp[i] = c[i];
+  for (unsigned int level = 1; level + 1 < order; level++)
+    for (unsigned int i = 0; i + level < order; i++)
+      tmp[i] = glyphy_lerp (tmp[i], tmp[i + 1], t);
+  if (direction)
+    *direction = {tmp[1].x - tmp[0].x, tmp[1].y - tmp[0].y};
+  tmp[0] = glyphy_lerp (tmp[0], tmp[1], t);
+  if (t <= 0) return c[0];
+  if (t >= 1) return c[order - 1];
+  return tmp[0];
+}
+
+/* Split c at t into left and right (de Casteljau). */
+static inline void
+glyphy_bezier_split (const glyphy_point_t *c, unsigned int order, double t,
+                     glyphy_point_t *left, glyphy_point_t *right)
+{
+  glyphy_point_t tmp[4];
+  for (unsigned int i = 0; i < order; i++)
+    tmp[i] = c[i];
+  left[0] = c[0];
+  right[order - 1] = c[order - 1];
+  for (unsigned int level = 1; level < order; level++) {
+    for (unsigned int i = 0; i + level < order; i++)
+      tmp[i] = glyphy_lerp (tmp[i], tmp[i + 1], t);
+    left[level] = tmp[0];
+    right[order - 1 - level] = tmp[order - 1 - level];
+  }
+}
+
+/* Parameters in (0, 1) where c turns back in x, or in y with axis set,
+ * that is, where its derivative changes sign.  Ascending; returns how
+ * many, at most two. */
+static inline unsigned int
+glyphy_bezier_turns (const glyphy_point_t *c, unsigned int order, bool axis,
+                     double t[2])
+{
+  double v[4];
+  for (unsigned int i = 0; i < order; i++)
+    v[i] = axis ? c[i].y : c[i].x;
+  double roots[2];
+  unsigned int num_roots = 0;
+
+  if (order == 3) {
+    double a = v[0] - 2 * v[1] + v[2];
+    if (a != 0)
+      roots[num_roots++] = (v[0] - v[1]) / a;
+  } else {
+    /* The derivative is 3 (e (1-t)² + 2 f (1-t) t + h t²). */
+    double e = v[1] - v[0], f = v[2] - v[1], h = v[3] - v[2];
+    double qa = e - 2 * f + h, qb = 2 * (f - e), qc = e;
+    if (fabs (qa) <= 1e-12 * (fabs (e) + fabs (f) + fabs (h))) {
+      if (qb != 0)
+        roots[num_roots++] = -qc / qb;
+    } else {
+      double disc = qb * qb - 4 * qa * qc;
+      /* A double root touches zero without a sign change. */
+      if (disc > 0) {
+        double q = -.5 * (qb + copysign (sqrt (disc), qb));
+        roots[num_roots++] = q / qa;
+        if (q != 0)
+          roots[num_roots++] = qc / q;
+      }
+    }
+  }
+
+  unsigned int n = 0;
+  for (unsigned int i = 0; i < num_roots; i++)
+    if (roots[i] > 0 && roots[i] < 1)
+      t[n++] = roots[i];
+  if (n == 2 && t[0] > t[1])
+    std::swap (t[0], t[1]);
+  return n;
+}
+
+/* Accumulated curves, one array per coordinate, so that bounds can be
+ * computed for several curves at once; see glyphy-bounds.cc.
+ *
+ * With GLYPHY_FLAG_FIXED_POINT the curves are quantized as they are
+ * added and only the q arrays are used; otherwise only the double
+ * arrays are.
+ *
+ * With GLYPHY_FLAG_NATIVE_CUBICS every curve is a cubic: p1 and p3 are
+ * its ends, p2 its first control point and pc its second.  Quadratic
+ * curves must then be added as cubics, with push_back_cubic(). */
+struct glyphy_curves_t {
+  bool fixed;
+  bool cubic;
+
+  std::vector<double> x1, y1;
+  std::vector<double> x2, y2;
+  std::vector<double> x3, y3;
+  std::vector<double> xc, yc;
+
+  std::vector<int16_t> qx1, qy1;
+  std::vector<int16_t> qx2, qy2;
+  std::vector<int16_t> qx3, qy3;
+  std::vector<int16_t> qxc, qyc;
+
+  unsigned int size () const { return fixed ? qx1.size () : x1.size (); }
+  bool empty () const { return !size (); }
+
+  void clear ()
+  {
+    x1.clear (); y1.clear ();
+    x2.clear (); y2.clear ();
+    x3.clear (); y3.clear ();
+    xc.clear (); yc.clear ();
+    qx1.clear (); qy1.clear ();
+    qx2.clear (); qy2.clear ();
+    qx3.clear (); qy3.clear ();
+    qxc.clear (); qyc.clear ();
+  }
+
+  void reserve (unsigned int n)
+  {
+    if (fixed) {
+      qx1.reserve (n); qy1.reserve (n);
+      qx2.reserve (n); qy2.reserve (n);
+      qx3.reserve (n); qy3.reserve (n);
+      if (cubic) {
+        qxc.reserve (n); qyc.reserve (n);
+      }
+    } else {
+      x1.reserve (n); y1.reserve (n);
+      x2.reserve (n); y2.reserve (n);
+      x3.reserve (n); y3.reserve (n);
+      if (cubic) {
+        xc.reserve (n); yc.reserve (n);
+      }
+    }
+  }
+
+  /* Quadratic c.  Returns false if a fixed-point coordinate does not
+   * fit. */
+  bool push_back (const glyphy_curve_t &c)
+  {
+    if (!fixed) {
+      x1.push_back (c.p1.x); y1.push_back (c.p1.y);
+      x2.push_back (c.p2.x); y2.push_back (c.p2.y);
+      x3.push_back (c.p3.x); y3.push_back (c.p3.y);
+      return true;
+    }
+
+    int16_t q[6];
+    if (!(glyphy_quantize_checked (c.p1.x, &q[0]) &
+          glyphy_quantize_checked (c.p1.y, &q[1]) &
+          glyphy_quantize_checked (c.p2.x, &q[2]) &
+          glyphy_quantize_checked (c.p2.y, &q[3]) &
+          glyphy_quantize_checked (c.p3.x, &q[4]) &
+          glyphy_quantize_checked (c.p3.y, &q[5])))
+      return false;
+    /* Collapsed to a point; it would not cross any ray. */
+    if (q[0] == q[2] && q[2] == q[4] && q[1] == q[3] && q[3] == q[5])
+      return true;
+    qx1.push_back (q[0]); qy1.push_back (q[1]);
+    qx2.push_back (q[2]); qy2.push_back (q[3]);
+    qx3.push_back (q[4]); qy3.push_back (q[5]);
+    return true;
+  }
+
+  /* Cubic p[0] .. p[3], for GLYPHY_FLAG_NATIVE_CUBICS.  Returns false
+   * if a fixed-point coordinate does not fit. */
+  bool push_back_cubic (const glyphy_point_t p[4])
+  {
+    if (!fixed) {
+      x1.push_back (p[0].x); y1.push_back (p[0].y);
+      x2.push_back (p[1].x); y2.push_back (p[1].y);
+      xc.push_back (p[2].x); yc.push_back (p[2].y);
+      x3.push_back (p[3].x); y3.push_back (p[3].y);
+      return true;
+    }
+
+    int16_t q[8];
+    if (!(glyphy_quantize_checked (p[0].x, &q[0]) &
+          glyphy_quantize_checked (p[0].y, &q[1]) &
+          glyphy_quantize_checked (p[1].x, &q[2]) &
+          glyphy_quantize_checked (p[1].y, &q[3]) &
+          glyphy_quantize_checked (p[2].x, &q[4]) &
+          glyphy_quantize_checked (p[2].y, &q[5]) &
+          glyphy_quantize_checked (p[3].x, &q[6]) &
+          glyphy_quantize_checked (p[3].y, &q[7])))
+      return false;
+    if (q[0] == q[2] && q[2] == q[4] && q[4] == q[6] &&
+        q[1] == q[3] && q[3] == q[5] && q[5] == q[7])
+      return true;
+    qx1.push_back (q[0]); qy1.push_back (q[1]);
+    qx2.push_back (q[2]); qy2.push_back (q[3]);
+    qxc.push_back (q[4]); qyc.push_back (q[5]);
+    qx3.push_back (q[6]); qy3.push_back (q[7]);
+    return true;
+  }
+
+  /* Drop all but the first n curves. */
+  void truncate (unsigned int n)
+  {
+    if (fixed) {
+      qx1.resize (n); qy1.resize (n);
+      qx2.resize (n); qy2.resize (n);
+      qx3.resize (n); qy3.resize (n);
+      if (cubic) {
+        qxc.resize (n); qyc.resize (n);
+      }
+    } else {
+      x1.resize (n); y1.resize (n);
+      x2.resize (n); y2.resize (n);
+      x3.resize (n); y3.resize (n);
+      if (cubic) {
+        xc.resize (n); yc.resize (n);
+      }
+    }
+  }
+
+  /* Copy curve from over curve to, to compact the arrays in place. */
+  void move (unsigned int from, unsigned int to)
+  {
+    if (fixed) {
+      qx1[to] = qx1[from]; qy1[to] = qy1[from];
+      qx2[to] = qx2[from]; qy2[to] = qy2[from];
+      qx3[to] = qx3[from]; qy3[to] = qy3[from];
+      if (cubic) {
+        qxc[to] = qxc[from]; qyc[to] = qyc[from];
+      }
+    } else {
+      x1[to] = x1[from]; y1[to] = y1[from];
+      x2[to] = x2[from]; y2[to] = y2[from];
+      x3[to] = x3[from]; y3[to] = y3[from];
+      if (cubic) {
+        xc[to] = xc[from]; yc[to] = yc[from];
+      }
+    }
+  }
+
+  /* Make curve i end where curve from ends. */
+  void set_end (unsigned int i, unsigned int from)
+  {
+    if (fixed) {
+      qx3[i] = qx3[from]; qy3[i] = qy3[from];
+    } else {
+      x3[i] = x3[from]; y3[i] = y3[from];
+    }
+  }
+
+  /* push_back() of count quadratics, points[3i .. 3i + 2], skipping
+   * those that start where they end.  Storage is grown once and written
+   * in place. */
+  bool append_quadratics (const glyphy_point_t *points, unsigned int count)
+  {
+    unsigned int n = size ();
+
+    if (!fixed) {
+      x1.resize (n + count); y1.resize (n + count);
+      x2.resize (n + count); y2.resize (n + count);
+      x3.resize (n + count); y3.resize (n + count);
+      for (unsigned int i = 0; i < count; i++) {
+        const glyphy_point_t *p = &points[3 * i];
+        x1[n] = p[0].x; y1[n] = p[0].y;
+        x2[n] = p[1].x; y2[n] = p[1].y;
+        x3[n] = p[2].x; y3[n] = p[2].y;
+        n += p[0].x != p[2].x || p[0].y != p[2].y;
+      }
+      x1.resize (n); y1.resize (n);
+      x2.resize (n); y2.resize (n);
+      x3.resize (n); y3.resize (n);
+      return true;
+    }
+
+    bool fits = true;
+    qx1.resize (n + count); qy1.resize (n + count);
+    qx2.resize (n + count); qy2.resize (n + count);
+    qx3.resize (n + count); qy3.resize (n + count);
+    for (unsigned int i = 0; i < count; i++) {
+      const glyphy_point_t *p = &points[3 * i];
+      fits &= glyphy_quantize_checked (p[0].x, &qx1[n]) &
+              glyphy_quantize_checked (p[0].y, &qy1[n]) &
+              glyphy_quantize_checked (p[1].x, &qx2[n]) &
+              glyphy_quantize_checked (p[1].y, &qy2[n]) &
+              glyphy_quantize_checked (p[2].x, &qx3[n]) &
+              glyphy_quantize_checked (p[2].y, &qy3[n]);
+      /* Also drop curves that collapsed to a point, as push_back() does */
+      n += (p[0].x != p[2].x || p[0].y != p[2].y) &&
+           (qx1[n] != qx2[n] || qx2[n] != qx3[n] ||
+            qy1[n] != qy2[n] || qy2[n] != qy3[n]);
+    }
+    qx1.resize (n); qy1.resize (n);
+    qx2.resize (n); qy2.resize (n);
+    qx3.resize (n); qy3.resize (n);
+    return fits;
+  }
+
+  /* Curve i; for cubics, without pc. */
+  glyphy_curve_t operator [] (unsigned int i) const
+  {
+    if (fixed) {
+      glyphy_curve_t c = {{glyphy_dequantize (qx1[i]), glyphy_dequantize (qy1[i])},
+                          {glyphy_dequantize (qx2[i]), glyphy_dequantize (qy2[i])},
+                          {glyphy_dequantize (qx3[i]), glyphy_dequantize (qy3[i])}};
+      return c;
+    }
+    glyphy_curve_t c = {{x1[i], y1[i]}, {x2[i], y2[i]}, {x3[i], y3[i]}};
+    return c;
+  }
+
+  /* Blob coordinates of curve i: p1.x, p1.y, p2.x, p2.y, p3.x, p3.y */
+  void get_quantized (unsigned int i, int16_t q[6]) const
+  {
+    if (fixed) {
+      q[0] = qx1[i]; q[1] = qy1[i];
+      q[2] = qx2[i]; q[3] = qy2[i];
+      q[4] = qx3[i]; q[5] = qy3[i];
+      return;
+    }
+    q[0] = glyphy_quantize (x1[i]); q[1] = glyphy_quantize (y1[i]);
+    q[2] = glyphy_quantize (x2[i]); q[3] = glyphy_quantize (y2[i]);
+    q[4] = glyphy_quantize (x3[i]); q[5] = glyphy_quantize (y3[i]);
+  }
+
+  /* Blob coordinates of cubic i, in curve order: p1, p2, pc, p3 */
+  void get_quantized_cubic (unsigned int i, int16_t q[8]) const
+  {
+    if (fixed) {
+      q[0] = qx1[i]; q[1] = qy1[i];
+      q[2] = qx2[i]; q[3] = qy2[i];
+      q[4] = qxc[i]; q[5] = qyc[i];
+      q[6] = qx3[i]; q[7] = qy3[i];
+      return;
+    }
+    q[0] = glyphy_quantize (x1[i]); q[1] = glyphy_quantize (y1[i]);
+    q[2] = glyphy_quantize (x2[i]); q[3] = glyphy_quantize (y2[i]);
+    q[4] = glyphy_quantize (xc[i]); q[5] = glyphy_quantize (yc[i]);
+    q[6] = glyphy_quantize (x3[i]); q[7] = glyphy_quantize (y3[i]);
+  }
+
+  /* Whether curve j starts where curve i ends. */
+  bool joins (unsigned int i, unsigned int j) const
+  {
+    if (fixed)
+      return qx3[i] == qx1[j] && qy3[i] == qy1[j];
+    return x3[i] == x1[j] && y3[i] == y1[j];
+  }
+
+  /* Whether curve i + 1 starts where curve i ends. */
+  bool continues (unsigned int i) const { return joins (i, i + 1); }
+};
+
+typedef struct {
+  double min_x;
+  double max_x;
+  double min_y;
+  double max_y;
+  int16_t qmin_x; /* Quantized bounds, as stored in the blob */
+  int16_t qmax_x;
+  int16_t qmin_y;
+  int16_t qmax_y;
+  bool is_horizontal;
+  bool is_vertical;
+  int hband_lo;
+  int hband_hi;
+  int vband_lo;
+  int vband_hi;
+} glyphy_curve_info_t;
+
+/* Per-axis band construction state, see build_bands(). */
+struct glyphy_bands_scratch_t {
+  unsigned int num_bands;
+  unsigned int index_len; /* Texels taken by all index lists */
+  unsigned int edge_len;  /* Texels taken by the edge table */
+
+  std::vector<unsigned int> curve_counts;
+  std::vector<unsigned int> offsets;
+  std::vector<unsigned int> cursors;
+  std::vector<unsigned int> curves;     /* Sorted by descending max */
+  std::vector<unsigned int> curves_asc; /* Sorted by ascending min */
+  std::vector<double>       splits;
+  std::vector<double>       edges;       /* Interior band edges */
+  std::vector<double>       sorted_mins; /* GLYPHY_FLAG_BALANCED_BANDS */
+  std::vector<double>       sorted_maxs;
+
+  std::vector<glyphy_sort_item_t> sort_items;
+  std::vector<glyphy_sort_item_t> sort_tmp;
+};
+
+/* Where overlap removal splits a curve; see glyphy-overlap.cc. */
+struct glyphy_overlap_split_t {
+  unsigned int   curve;
+  double         t;
+  glyphy_point_t p;
+};
+
+/* Where a kept piece starts (+1) or ends (-1), to check that the
+ * pieces close up. */
+struct glyphy_overlap_end_t {
+  glyphy_point_t p;
+  int            d;
+};
+
+/* GLYPHY_FLAG_REMOVE_OVERLAPS working memory. */
+struct glyphy_overlap_scratch_t {
+  std::vector<glyphy_point_t>         points; /* Four per curve */
+  std::vector<double>                 boxes;  /* min_x, min_y, max_x, max_y per curve */
+  std::vector<double>                 hits;   /* ta, tb of one curve pair */
+  std::vector<glyphy_overlap_split_t> splits;
+  std::vector<glyphy_point_t>         pieces; /* Four per piece */
+  std::vector<glyphy_overlap_end_t>   ends;
+};
+
+/* GLYPHY_FLAG_CELL_GRID working memory. */
+struct glyphy_cells_scratch_t {
+  std::vector<glyphy_point_t> points; /* Four per curve, in blob units */
+  std::vector<double>         boxes;  /* min_x, min_y, max_x, max_y per curve */
+  std::vector<uint8_t>        cells;  /* GLYPHY_CELL_* per cell, rows bottom up */
+};
+
+/* Per-axis sub-band construction state, see glyphy_build_sub_bands(). */
+struct glyphy_sub_bands_scratch_t {
+  unsigned int num_bands;
+  unsigned int num_cells; /* Over all bands */
+  unsigned int index_len; /* Texels taken by all index lists */
+
+  std::vector<unsigned int>       band_cells;   /* Sub-cells per band */
+  std::vector<unsigned int>       band_counts;  /* Curves per band */
+  std::vector<unsigned int>       band_offsets; /* Into band_curves */
+  std::vector<unsigned int>       band_curves;
+  std::vector<unsigned int>       cell_counts;
+  std::vector<unsigned int>       cell_offsets; /* Into curves */
+  std::vector<int>                cell_windings;
+  std::vector<unsigned int>       curves;       /* By descending max along the ray */
+  std::vector<glyphy_point_t>     points;       /* Four per curve, ray axis first */
+  std::vector<double>             boxes;        /* Likewise */
+  std::vector<uint8_t>            partial;      /* Per curve in the current band */
+  std::vector<glyphy_sort_item_t> sort_items;
+  std::vector<glyphy_sort_item_t> sort_tmp;
+};
+
+/* Encoder working memory.  Only ever grows, and survives glyphy_reset(),
+ * so that steady-state encoding does not touch the heap. */
+struct glyphy_scratch_t {
+  /* Layout of the current curves, see compute_layout() */
+  bool             layout_valid;
+  bool             keep_layout; /* Only rebuild the lists, see prepare_curves() */
+  bool             reworked;    /* Lay out prepared, not the accumulated curves */
+  bool             encodable;
+  glyphy_extents_t extents;
+  unsigned int     total_curve_indices;
+  unsigned int     blob_len;
+
+  std::vector<glyphy_curve_info_t> curve_infos;
+  std::vector<unsigned int>        curve_texel_offset;
+  glyphy_bands_scratch_t           hbands;
+  glyphy_bands_scratch_t           vbands;
+  glyphy_bands_scratch_t           trial_bands; /* GLYPHY_FLAG_ADAPTIVE_BANDS */
+  glyphy_curves_t                  prepared;    /* GLYPHY_FLAG_SIMPLIFY, GLYPHY_FLAG_REMOVE_OVERLAPS */
+  glyphy_overlap_scratch_t         overlap;     /* GLYPHY_FLAG_REMOVE_OVERLAPS */
+  glyphy_cells_scratch_t           cells;       /* GLYPHY_FLAG_CELL_GRID */
+  unsigned int                     cell_grid_len;
+  bool                             sub_bands;   /* GLYPHY_FLAG_SUB_BANDS */
+  glyphy_sub_bands_scratch_t       hsub;
+  glyphy_sub_bands_scratch_t       vsub;
+};
+
+/* Fill in the bounds, quantized bounds and flags of each curve, with
+ * empty band ranges, and the extents of all curves.  In glyphy-bounds.cc. */
+void
+glyphy_compute_curve_bounds (const glyphy_curves_t &curves,
+                             glyphy_curve_info_t   *infos,
+                             glyphy_extents_t      *extents);
+
+/* GLYPHY_FLAG_REMOVE_OVERLAPS: replace the curves with the boundary of
+ * the area they fill.  Returns false, leaving the curves alone, if
+ * that cannot be done reliably.  In glyphy-overlap.cc. */
+bool
+glyphy_remove_overlaps (glyphy_curves_t          &curves,
+                        glyphy_overlap_scratch_t &scratch);
+
+/* Nonzero winding number around p of curves of order 3 (quadratics)
+ * or 4 (cubics), given four control points and a control box (min_x,
+ * min_y, max_x, max_y) per curve.  In glyphy-overlap.cc. */
+int
+glyphy_winding_number (const glyphy_point_t *points,
+                       const double         *boxes,
+                       unsigned int          num_curves,
+                       unsigned int          order,
+                       const glyphy_point_t &p);
+
+/* Control points of curve i in blob units, as glyphy_winding_number()
+ * takes them.  Returns the curve's order. */
+static inline unsigned int
+glyphy_get_blob_points (const glyphy_curves_t &curves,
+                        unsigned int           i,
+                        glyphy_point_t         c[4])
+{
+  int16_t q[8];
+  unsigned int order = curves.cubic ? 4 : 3;
+  if (curves.cubic)
+    curves.get_quantized_cubic (i, q);
+  else
+    curves.get_quantized (i, q);
+  for (unsigned int k = 0; k < order; k++)
+    c[k] = {(double) q[2 * k], (double) q[2 * k + 1]};
+  return order;
+}
+
+/* GLYPHY_FLAG_CELL_GRID cell states, two bits each in the blob. */
+enum {
+  GLYPHY_CELL_EDGE  = 0, /* Curves pass through; run the curve loops */
+  GLYPHY_CELL_EMPTY = 1, /* Entirely outside the glyph */
+  GLYPHY_CELL_SOLID = 2  /* Entirely inside the glyph */
+};
+
+/* GLYPHY_FLAG_CELL_GRID: classify the cells of the grid over the
+ * quantized extents into scratch.cells.  Returns false if no cell is
+ * empty or solid, so the grid would not pay.  In glyphy-cells.cc. */
+bool
+glyphy_classify_cells (const glyphy_curves_t     &curves,
+                       const glyphy_curve_info_t *infos,
+                       const glyphy_extents_t    &extents,
+                       glyphy_cells_scratch_t    &scratch);
+
+/* Sub-bands (GLYPHY_FLAG_SUB_BANDS): split the quantized extents
+ * across one axis into num_bands bands, and each band along the ray
+ * into sub-cells, each with its own sorted curve list and the winding
+ * the curves left out of it add.  With keep_cells, each band keeps the
+ * sub-cell count of the last call.  In glyphy-sub-bands.cc. */
+void
+glyphy_build_sub_bands (const glyphy_curves_t      &curves,
+                        const glyphy_curve_info_t  *infos,
+                        const glyphy_extents_t     &extents,
+                        bool                        vertical,
+                        unsigned int                num_bands,
+                        glyphy_sub_bands_scratch_t &sub,
+                        bool                        keep_cells = false);
+
+/* GLYPHY_FLAG_NATIVE_CUBICS: draw the cubic from the current point
+ * through p1 and p2 to p3, as pieces that are monotonic in x and y.
+ * In glyphy-encode.cc. */
+void
+glyphy_emit_cubic (glyphy_t             *g,
+                   const glyphy_point_t *p1,
+                   const glyphy_point_t *p2,
+                   const glyphy_point_t *p3);
+
+/* Outline decoded by glyphy_glyf_append_glyph(), see glyphy-glyf.cc */
+struct glyphy_glyf_scratch_t {
+  std::vector<glyphy_point_t> points;
+  std::vector<unsigned char>  tags;
+  std::vector<unsigned int>   contour_ends;
+};
+
+/* A path for glyphy_encode_tiles(), see glyphy-tiles.cc: curves of
+ * one order, four points each, in em units. */
+struct glyphy_tile_path_t {
+  std::vector<glyphy_point_t> points;
+  std::vector<unsigned int>   contour_ends; /* Curve index past each contour */
+
+  unsigned int size () const { return points.size () / 4; }
+  void clear () { points.clear (); contour_ends.clear (); }
+};
+
+/* glyphy_encode_tiles() working memory. */
+struct glyphy_tiles_scratch_t {
+  glyphy_t                        *g;      /* Encodes one tile at a time */
+  glyphy_tile_path_t               source;
+  std::vector<glyphy_tile_path_t>  levels; /* Path clipped to the tile, per depth */
+  glyphy_tile_path_t               tmp[2];
+};
+
 struct glyphy_t {
   /* Accumulator state */
   glyphy_point_t start_point;
@@ -23,8 +665,27 @@ struct glyphy_t {
   unsigned int   num_curves;
   glyphy_bool_t  success;
 
+  /* Encoding options, see glyphy_flags_t */
+  unsigned int   flags;
+  unsigned int   max_blob_len;
+
+  /* Drawing options */
+  double         cu2qu_tolerance;
+
   /* Accumulated curves */
-  std::vector<glyphy_curve_t> curves;
+  glyphy_curves_t curves;
+
+  /* Encoder scratch */
+  glyphy_scratch_t scratch;
+
+  /* glyf reader scratch */
+  glyphy_glyf_scratch_t glyf;
+
+  /* glyphy_encode_tiles() scratch */
+  glyphy_tiles_scratch_t tiles;
+
+  /* glyphy_encode_parallel() blobs that did not fit the caller's buffer */
+  std::vector<glyphy_texel_t> parallel_blobs;
 };
 
 #endif /* GLYPHY_HH */